@@ -0,0 +1,85 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 18:32:07
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 18:32:07
+ * @Description: 日志收集工具, 接收各进程 NET 输出端发送的日志, 经文件输出端合并写入同一文件
+ */
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#include <nanomsg/nn.h>
+#include <nanomsg/pubsub.h>
+#include <nanomsg/pipeline.h>
+
+#include "io.h"
+
+using namespace tools::log;
+
+std::atomic<bool> g_stop{false};
+
+void OnStop(int) {
+  g_stop.store(true);
+}
+
+// log_collect address file [push|pub] [bytes|line]
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s address file [push|pub] [bytes|line]\n", argv[0]);
+    return 1;
+  }
+  bool publish = argc > 3 && strcmp(argv[3], "pub") == 0;
+  // 收集端绑定地址, 各进程的输出端连接至此
+  int sock = nn_socket(AF_SP, publish ? NN_SUB : NN_PULL);
+  if (sock < 0) {
+    fprintf(stderr, "nn_socket: %s\n", nn_strerror(nn_errno()));
+    return 1;
+  }
+  if (publish) nn_setsockopt(sock, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+  // 定期超时以响应退出信号
+  int timeout = 200;
+  nn_setsockopt(sock, NN_SOL_SOCKET, NN_RCVTIMEO, &timeout, sizeof(timeout));
+  if (nn_bind(sock, argv[1]) < 0) {
+    fprintf(stderr, "%s: %s\n", argv[1], nn_strerror(nn_errno()));
+    nn_close(sock);
+    return 1;
+  }
+
+  // 内容已由发送端格式化, 仅复用文件输出端的组提交及落盘策略
+  Config cfg{"log_collect", "%m", false, true, argv[2]};
+  cfg.flushPolicy = argc > 4 && strcmp(argv[4], "line") == 0 ? flush::EVERY_LINE : flush::BYTES;
+  Outputter outputter(cfg);
+  if (outputter.sinks().empty()) return 1;
+  auto& file = outputter.sinks().front().item;
+
+  signal(SIGINT, OnStop);
+  signal(SIGTERM, OnStop);
+  while (!g_stop.load()) {
+    char* buf = nullptr;
+    int n = nn_recv(sock, &buf, NN_MSG, 0);
+    if (n < 0) {
+      if (nn_errno() == ETIMEDOUT || nn_errno() == EAGAIN) {
+        // 空闲时将已接收的内容落盘
+        file->Flush();
+        continue;
+      }
+      if (nn_errno() == EINTR) continue;
+      fprintf(stderr, "nn_recv: %s\n", nn_strerror(nn_errno()));
+      break;
+    }
+    // 首字节为消息中的最高等级
+    if (n > 1) {
+      auto level = static_cast<level::LEVEL>(std::min<int>(buf[0], level::FATAL));
+      file->Write(level, std::string_view(buf + 1, n - 1));
+    }
+    nn_freemsg(buf);
+  }
+  file->Flush();
+  nn_close(sock);
+  return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 14:02:51
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 14:02:51
+ * @Description: 二进制日志解码工具, 使用与文本输出相同的 Formatter 还原日志
+ */
+
+#include <cstdio>
+
+#include "binary.h"
+#include "logger.h"
+
+using namespace tools::log;
+
+// log_decode file [pattern]
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s file [pattern]\n", argv[0]);
+    return 1;
+  }
+  bin::Reader reader;
+  if (!reader.Open(argv[1])) {
+    fprintf(stderr, "%s: bad binary log file\n", argv[1]);
+    return 1;
+  }
+  // 默认使用文件头中记录的日志器格式, 保证与文本输出一致
+  Formatter formatter;
+  formatter.Parse(argc > 2 ? argv[2] : reader.pattern());
+
+  Msg msg{};
+  std::string buffer;
+  while (reader.Next(msg)) {
+    buffer.clear();
+    formatter.Format(msg, buffer);
+    fwrite(buffer.data(), 1, buffer.size(), stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 21:03:15
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 21:03:15
+ * @Description: 日志查询工具, 按旁路索引直接定位时间范围内或包含指定等级的块, 无需顺序扫描整个文件
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <fstream>
+
+#include "index.h"
+
+using namespace tools::log;
+
+/**
+ * 解析时间, 支持自 1970-01-01 起的秒数(可带小数)及本地时间 "YYYY-mm-dd HH:MM:SS[.fraction]"
+ * @param str 时间字符串
+ * @param ns 自 1970-01-01 起的纳秒数
+ * @return 是否成功
+ */
+bool ParseTime(const char* str, int64_t& ns) {
+  struct tm _tm{};
+  double second = 0;
+  if (sscanf(str, "%d-%d-%d%*c%d:%d:%lf", &_tm.tm_year, &_tm.tm_mon, &_tm.tm_mday,
+             &_tm.tm_hour, &_tm.tm_min, &second) == 6) {
+    _tm.tm_year -= 1900;
+    _tm.tm_mon -= 1;
+    _tm.tm_sec = static_cast<int>(second);
+    _tm.tm_isdst = -1;
+    auto sec = mktime(&_tm);
+    if (sec == -1) return false;
+    ns = static_cast<int64_t>(sec) * 1000000000 + static_cast<int64_t>((second - _tm.tm_sec) * 1e9);
+    return true;
+  }
+  char* end = nullptr;
+  auto value = strtod(str, &end);
+  if (end == str || *end) return false;
+  ns = static_cast<int64_t>(value * 1e9);
+  return true;
+}
+
+bool ParseLevel(const char* str, level::LEVEL& level) {
+#define XX(LVL) \
+  if (strcmp(str, #LVL) == 0) { \
+    level = level::LVL; \
+    return true; \
+  }
+
+  XX(DEBUG)
+  XX(INFO)
+  XX(WARN)
+  XX(ERROR)
+  XX(FATAL)
+#undef XX
+  return false;
+}
+
+/**
+ * 输出范围内的内容, 指定 grep 时仅输出包含该字符串的行
+ */
+void Dump(std::ifstream& ifs, const idx::Range& range, const char* grep, std::string& line) {
+  ifs.clear();
+  ifs.seekg(static_cast<std::streamoff>(range.offset));
+  char buffer[64 * 1024];
+  auto remain = range.size;
+  while (remain > 0 && ifs) {
+    ifs.read(buffer, static_cast<std::streamsize>(std::min<uint64_t>(remain, sizeof(buffer))));
+    auto n = static_cast<size_t>(ifs.gcount());
+    if (!n) break;
+    remain -= n;
+    if (!grep) {
+      fwrite(buffer, 1, n, stdout);
+      continue;
+    }
+    // 逐行匹配, 跨越读取边界的行暂存于 line
+    size_t begin = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (buffer[i] != '\n') continue;
+      line.append(buffer + begin, i + 1 - begin);
+      if (line.find(grep) != std::string::npos) fwrite(line.data(), 1, line.size(), stdout);
+      line.clear();
+      begin = i + 1;
+    }
+    line.append(buffer + begin, n - begin);
+  }
+  if (grep && !line.empty() && line.find(grep) != std::string::npos) fwrite(line.data(), 1, line.size(), stdout);
+  line.clear();
+}
+
+// log_query file [-b begin] [-e end] [-l level] [-n logger] [-g text] [-s]
+// -b/-e 时间范围, -l 仅包含不低于该等级消息的块, -n 日志器名, -g 仅输出包含 text 的行, -s 仅输出索引统计及匹配范围
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s file [-b begin] [-e end] [-l level] [-n logger] [-g text] [-s]\n", argv[0]);
+    return 1;
+  }
+  idx::Query query;
+  const char* grep = nullptr;
+  bool stat = false;
+  for (int i = 2; i < argc; i++) {
+    bool ok = true;
+    bool value = i + 1 < argc;
+    if (strcmp(argv[i], "-s") == 0) {
+      stat = true;
+    } else if (strcmp(argv[i], "-b") == 0 && value) {
+      ok = ParseTime(argv[++i], query.begin);
+    } else if (strcmp(argv[i], "-e") == 0 && value) {
+      ok = ParseTime(argv[++i], query.end);
+    } else if (strcmp(argv[i], "-l") == 0 && value) {
+      level::LEVEL level;
+      ok = ParseLevel(argv[++i], level);
+      if (ok) query.levels = idx::AtLeast(level);
+    } else if (strcmp(argv[i], "-n") == 0 && value) {
+      query.logger = argv[++i];
+    } else if (strcmp(argv[i], "-g") == 0 && value) {
+      grep = argv[++i];
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "%s: invalid argument\n", argv[i]);
+      return 1;
+    }
+  }
+
+  // 压缩的历史文件不保留索引, 偏移对应的是压缩前的内容
+  if (std::string_view(argv[1]).ends_with(".gz")) {
+    fprintf(stderr, "%s: compressed archives are not indexed\n", argv[1]);
+    return 1;
+  }
+  idx::Reader reader;
+  if (!reader.Open(argv[1])) {
+    fprintf(stderr, "%s: missing or bad index %s\n", argv[1], idx::Path(argv[1]).c_str());
+    return 1;
+  }
+  auto ranges = reader.Find(query);
+  if (stat) {
+    uint64_t selected = 0;
+    for (auto& i : ranges) {
+      printf("range offset=%llu size=%llu\n", static_cast<unsigned long long>(i.offset),
+             static_cast<unsigned long long>(i.size));
+      selected += i.size;
+    }
+    printf("blocks=%zu indexed=%llu size=%llu selected=%llu\n", reader.blocks().size(),
+           static_cast<unsigned long long>(reader.indexed()), static_cast<unsigned long long>(reader.size()),
+           static_cast<unsigned long long>(selected));
+    return 0;
+  }
+  std::ifstream ifs(argv[1], std::ios::binary);
+  if (!ifs.is_open()) {
+    fprintf(stderr, "%s: cannot open\n", argv[1]);
+    return 1;
+  }
+  std::string line;
+  for (auto& i : ranges) {
+    Dump(ifs, i, grep, line);
+  }
+  return 0;
+}
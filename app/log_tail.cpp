@@ -0,0 +1,82 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 19:05:44
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 19:05:44
+ * @Description: 共享内存日志读取工具, 取出 SHM 输出端写入的日志, 经文件输出端写入文件
+ *               生产进程崩溃后以 -n 运行可取出剩余内容后退出
+ */
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "io.h"
+#include "shm.h"
+
+using namespace tools::log;
+
+/**
+ * 段不存在时创建的容量, 生产进程随后打开时沿用
+ */
+constexpr size_t k_default_capacity = 16 * 1024 * 1024;
+
+std::atomic<bool> g_stop{false};
+
+void OnStop(int) {
+  g_stop.store(true);
+}
+
+// log_tail name file [-n] [-u]
+// -n 取出当前内容后退出, -u 退出时删除共享内存段
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s name file [-n] [-u]\n", argv[0]);
+    return 1;
+  }
+  bool once = false;
+  bool remove = false;
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0) once = true;
+    if (strcmp(argv[i], "-u") == 0) remove = true;
+  }
+  shm::Ring ring;
+  if (!ring.Open(argv[1], once ? 0 : k_default_capacity)) {
+    fprintf(stderr, "%s: cannot open shared memory ring\n", argv[1]);
+    return 1;
+  }
+
+  // 内容已由生产进程格式化, 仅复用文件输出端的组提交及落盘策略
+  Config cfg{"log_tail", "%m", false, true, argv[2]};
+  cfg.flushPolicy = flush::BYTES;
+  Outputter outputter(cfg);
+  if (outputter.sinks().empty()) return 1;
+  auto& file = outputter.sinks().front().item;
+  auto write = [&](level::LEVEL level, std::string_view str) {
+    file->Write(level, str);
+  };
+
+  signal(SIGINT, OnStop);
+  signal(SIGTERM, OnStop);
+  auto idle = std::chrono::microseconds(0);
+  while (!g_stop.load()) {
+    if (ring.Read(write)) {
+      idle = std::chrono::microseconds(0);
+      continue;
+    }
+    if (once && !ring.pending()) break;
+    // 空闲时落盘, 随后逐步退避至 1ms 轮询
+    if (idle.count() == 0) file->Flush();
+    idle = std::min(idle + std::chrono::microseconds(50), std::chrono::microseconds(1000));
+    std::this_thread::sleep_for(idle);
+  }
+  ring.Read(write);
+  file->Flush();
+  if (ring.dropped()) fprintf(stderr, "%s: %llu records dropped by producers\n", argv[1],
+                              static_cast<unsigned long long>(ring.dropped()));
+  if (remove) shm::Ring::Remove(argv[1]);
+  return 0;
+}
@@ -6,16 +6,52 @@
  * @Description: 
  */
 
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <memory>
+#include <string>
+#include <cstring>
+#include <cstdint>
 #include <sstream>
+#include <charconv>
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+#include <tuple>
+
+#include <tick.h>
 
 #ifndef LOG_H
 #define LOG_H
 
+// 编译期最低输出等级(对应 level::LEVEL), 低于该等级的语句在编译期即被剔除
+// Release(NDEBUG) 下默认剔除 DEBUG
+#ifndef LOG_ACTIVE_LEVEL
+#ifdef NDEBUG
+#define LOG_ACTIVE_LEVEL    1
+#else
+#define LOG_ACTIVE_LEVEL    0
+#endif
+#endif
+
+// NAME 为字符串字面量时每个调用点缓存一个日志器句柄(函数内静态变量), 其余名称每次按名称查找
+// 空 lambda 的类型在每个调用点唯一, 用于区分各调用点的静态句柄
+#define T_LOG_HANDLE(NAME) tools::log::detail::Handle([]{}, NAME)
+
+// 每个调用点一份编译期常量描述(文件/文件名/函数/行号/等级), 消息仅持有其地址
+// FORMAT 仅二进制日志使用, 其余调用点为 nullptr
+#define T_LOG_SITE(FORMAT, LVL) \
+  static constexpr tools::log::CallSite _t_log_site { \
+    FORMAT, __FILE__, tools::log::BaseName(__FILE__), __FUNCTION__, __LINE__, tools::log::level::LVL }
+
+// 先判断等级再构建消息, 未启用时不会对参数求值
 #define T_LOG_IMPL(NAME, LVL, ...) \
-  tools::log::Log(__FILE__, __FUNCTION__, __LINE__, \
-    tools::log::level::LVL, NAME) << tools::log::Log::CStringToStdString(__VA_ARGS__)
+  if (!(tools::log::level::LVL >= LOG_ACTIVE_LEVEL)) {} \
+  else if (auto&& _t_log_handle = T_LOG_HANDLE(NAME); \
+           !_t_log_handle.IsEnabled(tools::log::level::LVL)) {} \
+  else if (T_LOG_SITE(nullptr, LVL); false) {} \
+  else tools::log::Log(_t_log_site, _t_log_handle).Printf(__VA_ARGS__)
 // Def Log
 #define LOG(...)    T_LOG_IMPL("", INFO, __VA_ARGS__)
 #define LOG_D(...)  T_LOG_IMPL("", DEBUG, __VA_ARGS__)
@@ -30,6 +66,117 @@
 #define CLOG_E(NAME, ...)  T_LOG_IMPL(NAME, ERROR, __VA_ARGS__)
 #define CLOG_F(NAME, ...)  T_LOG_IMPL(NAME, FATAL, __VA_ARGS__)
 
+// 格式化日志: "{}" 风格格式串, 编译期校验占位符数量及格式说明与参数类型是否匹配, 直接写入消息缓存
+#define T_LOG_FMT_IMPL(NAME, LVL, FORMAT, ...) \
+  if (!(tools::log::level::LVL >= LOG_ACTIVE_LEVEL)) {} \
+  else if (auto&& _t_log_handle = T_LOG_HANDLE(NAME); \
+           !_t_log_handle.IsEnabled(tools::log::level::LVL)) {} \
+  else if (T_LOG_SITE(nullptr, LVL); false) {} \
+  else tools::log::Log(_t_log_site, _t_log_handle).Format(FORMAT __VA_OPT__(,) __VA_ARGS__)
+// Def Format Log
+#define LOG_FMT(FORMAT, ...)    T_LOG_FMT_IMPL("", INFO, FORMAT, __VA_ARGS__)
+#define LOG_FMT_D(FORMAT, ...)  T_LOG_FMT_IMPL("", DEBUG, FORMAT, __VA_ARGS__)
+#define LOG_FMT_W(FORMAT, ...)  T_LOG_FMT_IMPL("", WARN, FORMAT, __VA_ARGS__)
+#define LOG_FMT_E(FORMAT, ...)  T_LOG_FMT_IMPL("", ERROR, FORMAT, __VA_ARGS__)
+#define LOG_FMT_F(FORMAT, ...)  T_LOG_FMT_IMPL("", FATAL, FORMAT, __VA_ARGS__)
+
+// Custom Format Log
+#define CLOG_FMT(NAME, FORMAT, ...)    T_LOG_FMT_IMPL(NAME, INFO, FORMAT, __VA_ARGS__)
+#define CLOG_FMT_D(NAME, FORMAT, ...)  T_LOG_FMT_IMPL(NAME, DEBUG, FORMAT, __VA_ARGS__)
+#define CLOG_FMT_W(NAME, FORMAT, ...)  T_LOG_FMT_IMPL(NAME, WARN, FORMAT, __VA_ARGS__)
+#define CLOG_FMT_E(NAME, FORMAT, ...)  T_LOG_FMT_IMPL(NAME, ERROR, FORMAT, __VA_ARGS__)
+#define CLOG_FMT_F(NAME, FORMAT, ...)  T_LOG_FMT_IMPL(NAME, FATAL, FORMAT, __VA_ARGS__)
+
+// printf 风格参数检查
+#if defined(__GNUC__) || defined(__clang__)
+#define T_LOG_PRINTF_CHECK(FORMAT_INDEX, ARGS_INDEX) __attribute__((format(printf, FORMAT_INDEX, ARGS_INDEX)))
+#else
+#define T_LOG_PRINTF_CHECK(FORMAT_INDEX, ARGS_INDEX)
+#endif
+
+// 二进制日志: 调用点信息(格式/文件/函数/行号/等级)以静态常量保存, 运行时仅拷贝参数,
+// 格式化延迟至写线程或离线工具 log_decode, 格式串为 printf 风格
+#define T_LOG_BIN_IMPL(NAME, LVL, FORMAT, ...) \
+  if (!(tools::log::level::LVL >= LOG_ACTIVE_LEVEL)) {} \
+  else if (auto&& _t_log_handle = T_LOG_HANDLE(NAME); \
+           !_t_log_handle.IsEnabled(tools::log::level::LVL)) {} \
+  else if (T_LOG_SITE(FORMAT, LVL); false) {} \
+  else tools::log::bin::Capture(_t_log_handle, _t_log_site __VA_OPT__(,) __VA_ARGS__)
+// Def Binary Log
+#define LOG_BIN(FORMAT, ...)    T_LOG_BIN_IMPL("", INFO, FORMAT, __VA_ARGS__)
+#define LOG_BIN_D(FORMAT, ...)  T_LOG_BIN_IMPL("", DEBUG, FORMAT, __VA_ARGS__)
+#define LOG_BIN_W(FORMAT, ...)  T_LOG_BIN_IMPL("", WARN, FORMAT, __VA_ARGS__)
+#define LOG_BIN_E(FORMAT, ...)  T_LOG_BIN_IMPL("", ERROR, FORMAT, __VA_ARGS__)
+#define LOG_BIN_F(FORMAT, ...)  T_LOG_BIN_IMPL("", FATAL, FORMAT, __VA_ARGS__)
+
+// Custom Binary Log
+#define CLOG_BIN(NAME, FORMAT, ...)    T_LOG_BIN_IMPL(NAME, INFO, FORMAT, __VA_ARGS__)
+#define CLOG_BIN_D(NAME, FORMAT, ...)  T_LOG_BIN_IMPL(NAME, DEBUG, FORMAT, __VA_ARGS__)
+#define CLOG_BIN_W(NAME, FORMAT, ...)  T_LOG_BIN_IMPL(NAME, WARN, FORMAT, __VA_ARGS__)
+#define CLOG_BIN_E(NAME, FORMAT, ...)  T_LOG_BIN_IMPL(NAME, ERROR, FORMAT, __VA_ARGS__)
+#define CLOG_BIN_F(NAME, FORMAT, ...)  T_LOG_BIN_IMPL(NAME, FATAL, FORMAT, __VA_ARGS__)
+
+// 采样/限流日志: 每个调用点以静态原子变量保存状态, 被抑制时不构建消息, 不分配内存也不加锁(首次抑制时登记调用点除外)
+// 被抑制的条数周期性地以 "suppressed N messages" 汇总输出(见 SetSuppressReportInterval)
+#define T_LOG_UNPACK(...) __VA_ARGS__
+#define T_LOG_SAMPLE_IMPL(NAME, LVL, SAMPLER, ARGS, ...) \
+  if (!(tools::log::level::LVL >= LOG_ACTIVE_LEVEL)) {} \
+  else if (auto&& _t_log_handle = T_LOG_HANDLE(NAME); \
+           !_t_log_handle.IsEnabled(tools::log::level::LVL)) {} \
+  else if (T_LOG_SITE(nullptr, LVL); false) {} \
+  else if (static tools::log::sample::SAMPLER _t_log_sampler; \
+           !_t_log_sampler.Allow(_t_log_handle, _t_log_site, T_LOG_UNPACK ARGS)) {} \
+  else tools::log::Log(_t_log_site, _t_log_handle).Printf(__VA_ARGS__)
+
+// 每 N 次输出一次(第 1, N+1, 2N+1 ... 次)
+#define LOG_EVERY_N(N, ...)    T_LOG_SAMPLE_IMPL("", INFO, EveryN, (N), __VA_ARGS__)
+#define LOG_EVERY_N_D(N, ...)  T_LOG_SAMPLE_IMPL("", DEBUG, EveryN, (N), __VA_ARGS__)
+#define LOG_EVERY_N_W(N, ...)  T_LOG_SAMPLE_IMPL("", WARN, EveryN, (N), __VA_ARGS__)
+#define LOG_EVERY_N_E(N, ...)  T_LOG_SAMPLE_IMPL("", ERROR, EveryN, (N), __VA_ARGS__)
+#define LOG_EVERY_N_F(N, ...)  T_LOG_SAMPLE_IMPL("", FATAL, EveryN, (N), __VA_ARGS__)
+#define CLOG_EVERY_N(NAME, N, ...)    T_LOG_SAMPLE_IMPL(NAME, INFO, EveryN, (N), __VA_ARGS__)
+#define CLOG_EVERY_N_D(NAME, N, ...)  T_LOG_SAMPLE_IMPL(NAME, DEBUG, EveryN, (N), __VA_ARGS__)
+#define CLOG_EVERY_N_W(NAME, N, ...)  T_LOG_SAMPLE_IMPL(NAME, WARN, EveryN, (N), __VA_ARGS__)
+#define CLOG_EVERY_N_E(NAME, N, ...)  T_LOG_SAMPLE_IMPL(NAME, ERROR, EveryN, (N), __VA_ARGS__)
+#define CLOG_EVERY_N_F(NAME, N, ...)  T_LOG_SAMPLE_IMPL(NAME, FATAL, EveryN, (N), __VA_ARGS__)
+
+// 仅输出前 N 次
+#define LOG_FIRST_N(N, ...)    T_LOG_SAMPLE_IMPL("", INFO, FirstN, (N), __VA_ARGS__)
+#define LOG_FIRST_N_D(N, ...)  T_LOG_SAMPLE_IMPL("", DEBUG, FirstN, (N), __VA_ARGS__)
+#define LOG_FIRST_N_W(N, ...)  T_LOG_SAMPLE_IMPL("", WARN, FirstN, (N), __VA_ARGS__)
+#define LOG_FIRST_N_E(N, ...)  T_LOG_SAMPLE_IMPL("", ERROR, FirstN, (N), __VA_ARGS__)
+#define LOG_FIRST_N_F(N, ...)  T_LOG_SAMPLE_IMPL("", FATAL, FirstN, (N), __VA_ARGS__)
+#define CLOG_FIRST_N(NAME, N, ...)    T_LOG_SAMPLE_IMPL(NAME, INFO, FirstN, (N), __VA_ARGS__)
+#define CLOG_FIRST_N_D(NAME, N, ...)  T_LOG_SAMPLE_IMPL(NAME, DEBUG, FirstN, (N), __VA_ARGS__)
+#define CLOG_FIRST_N_W(NAME, N, ...)  T_LOG_SAMPLE_IMPL(NAME, WARN, FirstN, (N), __VA_ARGS__)
+#define CLOG_FIRST_N_E(NAME, N, ...)  T_LOG_SAMPLE_IMPL(NAME, ERROR, FirstN, (N), __VA_ARGS__)
+#define CLOG_FIRST_N_F(NAME, N, ...)  T_LOG_SAMPLE_IMPL(NAME, FATAL, FirstN, (N), __VA_ARGS__)
+
+// 每 MS 毫秒最多输出一次
+#define LOG_EVERY_T(MS, ...)    T_LOG_SAMPLE_IMPL("", INFO, EveryT, (MS), __VA_ARGS__)
+#define LOG_EVERY_T_D(MS, ...)  T_LOG_SAMPLE_IMPL("", DEBUG, EveryT, (MS), __VA_ARGS__)
+#define LOG_EVERY_T_W(MS, ...)  T_LOG_SAMPLE_IMPL("", WARN, EveryT, (MS), __VA_ARGS__)
+#define LOG_EVERY_T_E(MS, ...)  T_LOG_SAMPLE_IMPL("", ERROR, EveryT, (MS), __VA_ARGS__)
+#define LOG_EVERY_T_F(MS, ...)  T_LOG_SAMPLE_IMPL("", FATAL, EveryT, (MS), __VA_ARGS__)
+#define CLOG_EVERY_T(NAME, MS, ...)    T_LOG_SAMPLE_IMPL(NAME, INFO, EveryT, (MS), __VA_ARGS__)
+#define CLOG_EVERY_T_D(NAME, MS, ...)  T_LOG_SAMPLE_IMPL(NAME, DEBUG, EveryT, (MS), __VA_ARGS__)
+#define CLOG_EVERY_T_W(NAME, MS, ...)  T_LOG_SAMPLE_IMPL(NAME, WARN, EveryT, (MS), __VA_ARGS__)
+#define CLOG_EVERY_T_E(NAME, MS, ...)  T_LOG_SAMPLE_IMPL(NAME, ERROR, EveryT, (MS), __VA_ARGS__)
+#define CLOG_EVERY_T_F(NAME, MS, ...)  T_LOG_SAMPLE_IMPL(NAME, FATAL, EveryT, (MS), __VA_ARGS__)
+
+// 令牌桶限流: 每秒补充 RATE 个, 最多累积 BURST 个
+#define LOG_RATE_LIMITED(RATE, BURST, ...)    T_LOG_SAMPLE_IMPL("", INFO, RateLimited, (RATE, BURST), __VA_ARGS__)
+#define LOG_RATE_LIMITED_D(RATE, BURST, ...)  T_LOG_SAMPLE_IMPL("", DEBUG, RateLimited, (RATE, BURST), __VA_ARGS__)
+#define LOG_RATE_LIMITED_W(RATE, BURST, ...)  T_LOG_SAMPLE_IMPL("", WARN, RateLimited, (RATE, BURST), __VA_ARGS__)
+#define LOG_RATE_LIMITED_E(RATE, BURST, ...)  T_LOG_SAMPLE_IMPL("", ERROR, RateLimited, (RATE, BURST), __VA_ARGS__)
+#define LOG_RATE_LIMITED_F(RATE, BURST, ...)  T_LOG_SAMPLE_IMPL("", FATAL, RateLimited, (RATE, BURST), __VA_ARGS__)
+#define CLOG_RATE_LIMITED(NAME, RATE, BURST, ...)    T_LOG_SAMPLE_IMPL(NAME, INFO, RateLimited, (RATE, BURST), __VA_ARGS__)
+#define CLOG_RATE_LIMITED_D(NAME, RATE, BURST, ...)  T_LOG_SAMPLE_IMPL(NAME, DEBUG, RateLimited, (RATE, BURST), __VA_ARGS__)
+#define CLOG_RATE_LIMITED_W(NAME, RATE, BURST, ...)  T_LOG_SAMPLE_IMPL(NAME, WARN, RateLimited, (RATE, BURST), __VA_ARGS__)
+#define CLOG_RATE_LIMITED_E(NAME, RATE, BURST, ...)  T_LOG_SAMPLE_IMPL(NAME, ERROR, RateLimited, (RATE, BURST), __VA_ARGS__)
+#define CLOG_RATE_LIMITED_F(NAME, RATE, BURST, ...)  T_LOG_SAMPLE_IMPL(NAME, FATAL, RateLimited, (RATE, BURST), __VA_ARGS__)
+
+
 
 namespace tools {
 namespace log {
@@ -43,21 +190,132 @@ enum LEVEL : uint8_t {
   INFO,
   WARN,
   ERROR,
-  FATAL,
+  FATAL,      // 同步输出并落盘, 异步模式下先排空队列
   NUM_LEVEL
 };
 
 } // level
 
+/**
+ * 调用点描述, 每个调用点一份静态常量
+ */
+struct CallSite {
+  const char* format;   // 二进制日志的 printf 风格格式, 非空时内容延迟格式化, 其余调用点为空
+  const char* file;     // 文件路径
+  const char* base;     // 文件名(不含路径), 编译期计算
+  const char* func;     // 函数名
+  uint32_t line;        // 行号
+  level::LEVEL level;   // 等级枚举
+};
+
+/**
+ * 取路径中的文件名部分, 用于在编译期计算 CallSite::base
+ * @param path 路径
+ * @return 指向 path 中文件名起始处
+ */
+constexpr const char* BaseName(const char* path) {
+  auto base = path;
+  for (auto p = path; *p; ++p) {
+#ifdef _WIN32
+    if (*p == '/' || *p == '\\') base = p + 1;
+#else
+    if (*p == '/') base = p + 1;
+#endif
+  }
+  return base;
+}
+
+namespace overflow {
+/**
+ * 异步队列满时的处理策略
+ */
+enum POLICY : uint8_t {
+  BLOCK = 0,      // 阻塞生产者直至队列有空位
+  DROP_NEWEST,    // 丢弃当前待入队的消息
+  DROP_OLDEST,    // 丢弃队列中最旧的消息
+};
+
+} // overflow
+
+namespace flush {
+/**
+ * 文件落盘策略, 待写入的多行会在触发时合并写入并统一 fsync
+ */
+enum POLICY : uint8_t {
+  EVERY_LINE = 0, // 每行落盘
+  BYTES,          // 累计达到 flushBytes 字节时落盘
+  INTERVAL,       // 每隔 flushInterval 毫秒落盘
+  ON_LEVEL,       // 遇到不低于 flushLevel 的消息, 显式 Flush() 或累计达到 flushBytes 字节时落盘
+};
+
+} // flush
+
+namespace rotate {
+/**
+ * 文件按时间轮转的周期, 以本地时间的整点/零点为界
+ */
+enum POLICY : uint8_t {
+  NONE = 0,       // 不按时间轮转
+  HOURLY,         // 每小时
+  DAILY,          // 每天
+};
+
+} // rotate
+
+namespace sink {
+/**
+ * 文本输出端类型
+ */
+enum TYPE : uint8_t {
+  CONSOLE = 0,    // 控制台
+  FILE,           // 文件, 落盘/轮转/内存映射等策略沿用日志器配置
+  NET,            // 经 nanomsg 发送至收集进程(log_collect), 由其统一写入文件
+  SHM,            // 写入共享内存环, 由读取进程(log_tail)取出并写入文件, 仅 unix 可用
+};
+
+} // sink
+
+/**
+ * 文本输出端配置, 各输出端可使用独立的等级与格式
+ * 格式相同的输出端共用同一份格式化结果, 每条消息每种格式仅格式化一次
+ */
+struct SinkConfig {
+  sink::TYPE type = sink::CONSOLE;        // 输出端类型
+  level::LEVEL minLevel = level::DEBUG;   // 输出端最低输出等级
+  std::string pattern = {};               // 输出格式, 为空时使用日志器的格式
+  std::string fileName = {};              // FILE 类型的文件路径
+  std::string address = {};               // NET 类型的 nanomsg 地址, 如 ipc:///tmp/log.ipc, tcp://127.0.0.1:5560
+  bool publish = false;                   // NET 类型以 PUB 发送, 否则以 PUSH 发送
+  size_t shmSize = 16 * 1024 * 1024;      // SHM 类型新建共享内存段的容量, 段名称取自 address, 如 "/app.log"
+};
+
+/**
+ * 异步输出配置
+ * 开启后生产者仅将消息入队, 由后台写线程负责格式化与输出
+ * 每个生产线程拥有独立的队列, 线程退出时队列中剩余消息仍会输出
+ */
+struct AsyncConfig {
+  size_t capacity = 8192;                       // 单个线程的队列容量(消息条数), 向上取整为 2 的幂
+                                                // 每条消息内联存放于队列中(约 400 字节), 队列按 64 条一块在积压时才分配,
+                                                // 占用随实际积压深度增长, 积压至容量时每个生产线程约 3MB
+  overflow::POLICY policy = overflow::BLOCK;    // 队列满时的处理策略
+  bool ordered = false;                         // 按各线程队首的时间戳归并输出, 已入队的消息按时间顺序输出;
+                                                // 时间戳早于已输出消息但入队较晚的消息仍按入队顺序输出
+};
+
 /**
  * 日志器配置
  * 格式参数如下:
+ * d -- 时间, 可用 %d{...} 指定 strftime 格式, 额外支持 %L 毫秒, %f 微秒, %N 纳秒
  * p -- 日志等级
  * f -- 文件名
  * c -- 函数名
  * l -- 行号
  * m -- 消息
+ * k -- 结构化字段(Log::With), 以 "key=value " 逐个输出
  * eg. "%d [%p](%f:%l@%c) %m"
+ * 文件轮转时当前文件重命名为 "fileName.YYYYmmdd-HHMMSS"(文件创建时间), 仅普通文本文件支持轮转
+ * 索引记录每块的偏移/时间范围/等级位图, 由 log_query 按时间或等级定位, 仅普通文本文件(非内存映射)支持索引
  */
 struct Config {
   std::string name;             // 名称/Key(Unique)
@@ -65,6 +323,24 @@ struct Config {
   bool toConsole;               // 是否输出至控制台
   bool toFile;                  // 是否输出至文件
   std::string fileName;         // 文件路径
+  flush::POLICY flushPolicy = flush::EVERY_LINE;  // 文件落盘策略, 控制台输出至管道/文件时参照其写出
+  size_t flushBytes = 64 * 1024;                  // BYTES 策略的落盘阈值, 亦为 ON_LEVEL 策略的累计上限
+  uint32_t flushInterval = 1000;                  // INTERVAL 策略的落盘间隔(毫秒)
+  level::LEVEL flushLevel = level::WARN;          // ON_LEVEL 策略的触发等级
+  bool syncOnError = true;                        // ERROR/FATAL 是否立即落盘
+  level::LEVEL minLevel = level::DEBUG;           // 日志器最低输出等级
+  bool binary = false;                            // 文件以二进制格式输出, 由 log_decode 还原
+  bool mmap = false;                              // 以内存映射方式写入文件, 落盘策略仅 syncOnError 生效
+  size_t mmapChunk = 16 * 1024 * 1024;            // 内存映射时每次扩展的文件大小
+  size_t rotateBytes = 0;                         // 文件达到该大小时轮转, 0 为不限制
+  rotate::POLICY rotatePolicy = rotate::NONE;     // 按时间轮转的周期
+  uint32_t rotateKeep = 0;                        // 保留的历史文件数, 0 为不限制
+  bool rotateCompress = false;                    // 历史文件在后台以 gzip 压缩
+  bool consoleColor = false;                      // 控制台按等级以 ANSI 颜色输出
+  bool consoleStderr = false;                     // 控制台 ERROR/FATAL 输出至标准错误
+  std::string jsonFile = {};                      // JSON Lines 输出文件, 含结构化字段, 为空时不输出
+  std::vector<SinkConfig> sinks = {};             // 额外的文本输出端, 与 toConsole/toFile 可同时使用
+  size_t indexBlock = 0;                          // 文本文件每写入约该字节数在 "fileName.idx" 中记录一项索引, 0 为不生成; 压缩的历史文件不保留索引
 };
 
 /**
@@ -105,23 +381,870 @@ void SetLevel(level::LEVEL level);
  */
 level::LEVEL GetLevel();
 
+/**
+ * 设置指定日志器的最低输出等级, 实际生效等级取其与全局等级中的较高者
+ * @param name 日志器名, 为空时对应默认日志器
+ * @param level 等级枚举
+ * @return 日志器不存在时返回失败
+ */
+bool SetLevel(const std::string& name, level::LEVEL level);
+
+/**
+ * 开启异步输出, 已开启时返回失败
+ * @param cfg 异步输出配置
+ * @return 是否开启成功
+ */
+bool EnableAsync(const AsyncConfig& cfg = {});
+
+/**
+ * 关闭异步输出, 队列中剩余消息会在返回前输出完毕
+ */
+void DisableAsync();
+
+/**
+ * 等待当前已提交的消息全部输出完毕, 并将所有文件中待写入的内容落盘
+ */
+void Flush();
+
+/**
+ * 设置采样/限流日志汇总被抑制条数的周期, 默认 10 秒
+ * @param ms 周期(毫秒)
+ */
+void SetSuppressReportInterval(uint32_t ms);
+
+/**
+ * 耗时直方图(纳秒), 按 2 的幂分桶, 第 i 个桶统计 [2^(i-1), 2^i) 纳秒, 第 0 个桶统计 0
+ */
+struct Histogram {
+  static constexpr size_t k_buckets = 40;
+  uint64_t count = 0;   // 样本数
+  uint64_t sum = 0;     // 总耗时
+  uint64_t max = 0;     // 最大耗时
+  uint64_t buckets[k_buckets] = {};
+  /**
+   * 平均耗时
+   */
+  double Mean() const;
+  /**
+   * 分位数, 返回所在桶的上界(不超过最大值)
+   * @param p 百分位, 取值 [0, 100]
+   */
+  uint64_t Percentile(double p) const;
+};
+
+/**
+ * 单个日志器的统计
+ */
+struct LoggerStats {
+  std::string name;         // 日志器名称, 默认日志器为 "root"
+  uint64_t messages = 0;    // 已输出的消息数
+  uint64_t bytes = 0;       // 格式化后写出的字节数(文本及 JSON)
+  uint64_t dropped = 0;     // 异步队列满时被丢弃的消息数
+  uint64_t filtered = 0;    // 进入管理器后因等级被忽略的消息数(宏中即被过滤的不计入)
+  Histogram format;         // 每条消息的格式化耗时, 批量输出时批内每条计为平均值
+  Histogram write;          // 每次写入输出端的耗时
+  Histogram sync;           // 每次落盘(fsync)的耗时
+};
+
+/**
+ * 日志统计, 读取时汇总各线程的计数
+ */
+struct Stats {
+  std::vector<LoggerStats> loggers;   // 默认日志器及所有已注册日志器
+  uint64_t queueDepth = 0;            // 异步队列中待输出的消息数
+};
+
+/**
+ * 获取日志统计
+ * @return 统计快照
+ */
+Stats GetStats();
+
+/**
+ * 设置周期性输出统计的间隔, 由默认日志器以 INFO 等级为每个日志器输出一行
+ * @param ms 间隔(毫秒), 0 为关闭
+ */
+void SetStatsReportInterval(uint32_t ms);
+
+/**
+ * 安装崩溃处理函数(SIGSEGV/SIGABRT 等), 收到信号时以异步信号安全的方式
+ * 写出各输出端缓存及异步队列中的消息并落盘, 随后按默认方式退出
+ * 已格式化的缓存内容原样写出; 异步队列中尚未格式化的消息不使用日志器的格式, 以
+ * "!CRASH 秒.微秒 [等级] (文件:行号) 内容" 的固定格式写入各文本输出端, 解析日志时需识别该前缀
+ * 栈溢出时处理函数需运行在备用信号栈上, 备用信号栈仅对调用线程及库创建的后台线程生效,
+ * 其他线程需各自调用 InstallCrashStack
+ * @return 是否成功
+ */
+bool InstallCrashHandler();
+
+/**
+ * 为当前线程设置崩溃处理使用的备用信号栈, 已设置时不做修改
+ * @return 是否成功
+ */
+bool InstallCrashStack();
+
+class LoggerSlot;
+
+/**
+ * 日志器句柄, 构造时按名称查找一次, 之后直接定位日志器且无需哈希
+ * 日志器未注册时交予默认日志器输出, 注册/反注册后句柄自动生效
+ */
+class LoggerHandle {
+ public:
+  /**
+   * @param name 日志器名
+   */
+  explicit LoggerHandle(const std::string& name);
+  /**
+   * 判断等级是否会被输出, 实际生效等级为日志器自身等级与全局等级中的较高者
+   * @param level 等级枚举
+   * @return 是否输出
+   */
+  inline bool IsEnabled(level::LEVEL level) const {
+    return level >= level_->load(std::memory_order_relaxed);
+  }
+  /**
+   * 获取实际生效的最低输出等级
+   * @return 等级枚举
+   */
+  inline level::LEVEL level() const {
+    return static_cast<level::LEVEL>(level_->load(std::memory_order_relaxed));
+  }
+  inline LoggerSlot* slot() const {
+    return slot_;
+  }
+ private:
+  LoggerSlot* slot_;
+  const std::atomic<uint8_t>* level_;
+};
+
+namespace detail {
+
+/**
+ * 字符串字面量(及常量字符数组)的名称, 首次调用时查找并缓存
+ * @param name 日志器名
+ */
+template <typename Site, size_t N>
+inline const LoggerHandle& Handle(Site, const char (&name)[N]) {
+  static const LoggerHandle handle(name);
+  return handle;
+}
+
+/**
+ * 可修改的字符数组, 内容可能变化, 每次查找
+ */
+template <typename Site, size_t N>
+inline LoggerHandle Handle(Site, char (&name)[N]) {
+  return LoggerHandle(name);
+}
+
+/**
+ * 运行期名称(变量, 函数返回值等), 每次查找
+ */
+template <typename Site>
+inline LoggerHandle Handle(Site, const std::string& name) {
+  return LoggerHandle(name);
+}
+
+} // detail
+
+/**
+ * 带内联缓存的字符缓冲, 短消息无需分配内存, 超出内联容量时转移至堆上
+ * 移动时堆上的内存直接转移, 内联内容仅拷贝已使用部分
+ */
+class LogBuffer {
+ public:
+  static constexpr size_t k_inline_size = 256;
+ public:
+  LogBuffer() = default;
+  LogBuffer(std::string_view str) {
+    append(str);
+  }
+  LogBuffer(const char* str)
+      : LogBuffer(std::string_view(str)) {}
+  LogBuffer(const LogBuffer& other) {
+    append(other);
+  }
+  LogBuffer(LogBuffer&& other) noexcept {
+    Steal(other);
+  }
+  ~LogBuffer() {
+    Release();
+  }
+  LogBuffer& operator=(const LogBuffer& other) {
+    if (this != &other) {
+      clear();
+      append(other);
+    }
+    return *this;
+  }
+  LogBuffer& operator=(LogBuffer&& other) noexcept {
+    if (this != &other) {
+      Release();
+      Steal(other);
+    }
+    return *this;
+  }
+  LogBuffer& operator=(std::string_view str) {
+    clear();
+    append(str);
+    return *this;
+  }
+  inline operator std::string_view() const {
+    return {data_, size_};
+  }
+  inline const char* data() const {
+    return data_;
+  }
+  inline size_t size() const {
+    return size_;
+  }
+  inline size_t capacity() const {
+    return capacity_;
+  }
+  inline bool empty() const {
+    return size_ == 0;
+  }
+  inline void clear() {
+    size_ = 0;
+  }
+  inline std::string str() const {
+    return {data_, size_};
+  }
+  inline void push_back(char c) {
+    if (size_ == capacity_) Grow(1);
+    data_[size_++] = c;
+  }
+  inline void append(const char* str, size_t size) {
+    if (size_ + size > capacity_) Grow(size);
+    memcpy(data_ + size_, str, size);
+    size_ += size;
+  }
+  inline void append(std::string_view str) {
+    append(str.data(), str.size());
+  }
+  /**
+   * 预留可写空间, 写入后调用 Commit 提交实际长度
+   * @param size 最大写入长度
+   * @return 写入位置
+   */
+  inline char* Prepare(size_t size) {
+    if (size_ + size > capacity_) Grow(size);
+    return data_ + size_;
+  }
+  inline void Commit(size_t size) {
+    size_ += size;
+  }
+ private:
+  void Grow(size_t size) {
+    auto capacity = std::max(capacity_ * 2, size_ + size);
+    auto data = new char[capacity];
+    memcpy(data, data_, size_);
+    Release();
+    data_ = data;
+    capacity_ = capacity;
+  }
+  void Release() {
+    if (data_ != inline_) delete[] data_;
+    data_ = inline_;
+    capacity_ = k_inline_size;
+  }
+  void Steal(LogBuffer& other) {
+    if (other.data_ == other.inline_) {
+      memcpy(inline_, other.inline_, other.size_);
+    } else {
+      data_ = other.data_;
+      capacity_ = other.capacity_;
+      other.data_ = other.inline_;
+      other.capacity_ = k_inline_size;
+    }
+    size_ = other.size_;
+    other.size_ = 0;
+  }
+ private:
+  char* data_ = inline_;
+  size_t size_ = 0;
+  size_t capacity_ = k_inline_size;
+  char inline_[k_inline_size];
+};
+
+/**
+ * 日志流, 直接写入 LogBuffer, 未使用格式控制时不构造 std::ostream
+ * 算术类型经 std::to_chars 转换, 输出与 std::ostream 默认格式一致
+ * 使用 setw/setprecision/setfill/fixed/showbase 等格式控制后, 格式状态保存在内部的 std::ostringstream 中,
+ * 此后的输出经其转换, 与 std::ostream 的行为一致; 仅使用 boolalpha/dec/hex/oct 时仍走快速路径
+ */
+class LogStream {
+ public:
+  template <typename T>
+  LogStream& operator<<(const T& value) {
+    using U = std::decay_t<T>;
+    if constexpr (requires(std::ostream& os) { os << value; }) {
+      if (!Plain()) {
+        Stream() << value;
+        Take();
+        return *this;
+      }
+    }
+    if constexpr (std::is_same_v<U, bool>) {
+      if (boolalpha()) {
+        buffer_.append(value ? std::string_view("true") : std::string_view("false"));
+      } else {
+        buffer_.push_back(value ? '1' : '0');
+      }
+    } else if constexpr (std::is_same_v<U, char> || std::is_same_v<U, signed char> || std::is_same_v<U, unsigned char>) {
+      buffer_.push_back(static_cast<char>(value));
+    } else if constexpr (std::is_integral_v<U>) {
+      // 与 std::ostream 一致, 非十进制时按无符号输出
+      constexpr size_t k_max = sizeof(U) * 8 + 1;
+      auto ptr = buffer_.Prepare(k_max);
+      auto base = this->base();
+      auto res = base == 10 ? std::to_chars(ptr, ptr + k_max, value)
+                            : std::to_chars(ptr, ptr + k_max, static_cast<std::make_unsigned_t<U> >(value), base);
+      buffer_.Commit(res.ptr - ptr);
+    } else if constexpr (std::is_floating_point_v<U>) {
+      // 对应 std::ostream 默认的 %g 及 6 位精度
+      constexpr size_t k_max = 32;
+      auto ptr = buffer_.Prepare(k_max);
+      auto res = std::to_chars(ptr, ptr + k_max, value, std::chars_format::general, 6);
+      buffer_.Commit(res.ptr - ptr);
+    } else if constexpr (std::is_null_pointer_v<U>) {
+      buffer_.append(std::string_view("nullptr"));
+    } else if constexpr (std::is_array_v<T> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T> >, char>) {
+      // 仅字符数组按字符串输出, 其余数组退化为指针
+      buffer_.append(std::string_view(value));
+    } else if constexpr (std::is_same_v<U, const char*> || std::is_same_v<U, char*>) {
+      if (value) buffer_.append(std::string_view(value));
+    } else if constexpr (std::is_convertible_v<const U&, std::string_view>) {
+      buffer_.append(std::string_view(value));
+    } else if constexpr (std::is_pointer_v<U>) {
+      auto address = reinterpret_cast<uintptr_t>(static_cast<const volatile void*>(value));
+      if (!address) {
+        buffer_.push_back('0');
+      } else {
+        auto ptr = buffer_.Prepare(2 + sizeof(uintptr_t) * 2);
+        ptr[0] = '0';
+        ptr[1] = 'x';
+        auto res = std::to_chars(ptr + 2, ptr + 2 + sizeof(uintptr_t) * 2, address, 16);
+        buffer_.Commit(res.ptr - ptr);
+      }
+    } else {
+      // 包括 setw/setprecision/setfill 等格式控制, 作用于内部流并保留至之后的输出
+      Stream() << value;
+      Take();
+    }
+    return *this;
+  }
+  /**
+   * 用于适配 std::endl, std::ends, std::flush
+   */
+  LogStream& operator<<(std::ostream& (*func)(std::ostream&)) {
+    if (func == static_cast<std::ostream& (*)(std::ostream&)>(std::endl)) {
+      buffer_.push_back('\n');
+    } else if (func == static_cast<std::ostream& (*)(std::ostream&)>(std::ends)) {
+      buffer_.push_back('\0');
+    }
+    return *this;
+  }
+  /**
+   * 用于适配 std::boolalpha, std::hex, std::fixed 等格式标记
+   */
+  LogStream& operator<<(std::ios_base& (*func)(std::ios_base&)) {
+    func(Stream());
+    return *this;
+  }
+  inline LogBuffer& buffer() {
+    return buffer_;
+  }
+ private:
+  /**
+   * 格式状态与 std::ostream 默认状态的差异仅限 boolalpha 及进制时可走快速路径
+   */
+  inline bool Plain() const {
+    if (!state_) return true;
+    auto flags = state_->flags() & ~(std::ios_base::boolalpha | std::ios_base::basefield | std::ios_base::skipws);
+    return !flags && state_->width() == 0 && state_->precision() == 6;
+  }
+  inline bool boolalpha() const {
+    return state_ && (state_->flags() & std::ios_base::boolalpha);
+  }
+  inline int base() const {
+    if (!state_) return 10;
+    auto base = state_->flags() & std::ios_base::basefield;
+    return base == std::ios_base::hex ? 16 : base == std::ios_base::oct ? 8 : 10;
+  }
+  /**
+   * 保存格式状态的内部流, 首次使用时创建
+   */
+  std::ostringstream& Stream() {
+    if (!state_) state_ = std::make_unique<std::ostringstream>();
+    return *state_;
+  }
+  /**
+   * 将内部流的输出移入缓存, 格式状态保留
+   */
+  void Take() {
+    auto str = state_->str();
+    if (str.empty()) return;
+    buffer_.append(str);
+    state_->str({});
+  }
+ private:
+  LogBuffer buffer_;
+  std::unique_ptr<std::ostringstream> state_;
+};
+
+namespace fmt {
+/**
+ * 参数类别, 用于编译期校验格式说明
+ */
+enum KIND : uint8_t {
+  BOOL = 0,
+  CHAR,
+  INT,
+  FLOAT,
+  STRING,
+  POINTER,
+  OTHER,        // 反射结构体/容器/支持 std::ostream 输出的类型, 不支持格式说明
+};
+
+template <typename T>
+constexpr KIND KindOf() {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_same_v<U, bool>) {
+    return BOOL;
+  } else if constexpr (std::is_same_v<U, char> || std::is_same_v<U, signed char> || std::is_same_v<U, unsigned char>) {
+    return CHAR;
+  } else if constexpr (std::is_integral_v<U>) {
+    return INT;
+  } else if constexpr (std::is_floating_point_v<U>) {
+    return FLOAT;
+  } else if constexpr (std::is_null_pointer_v<U>) {
+    return POINTER;
+  } else if constexpr (std::is_convertible_v<const U&, std::string_view>) {
+    return STRING;
+  } else if constexpr (std::is_pointer_v<U>) {
+    return POINTER;
+  } else {
+    return OTHER;
+  }
+}
+
+/**
+ * 格式说明, 语法为 {:[0][width][.precision][type]}
+ * type: d 十进制, x/X 十六进制, o 八进制, b 二进制, c 字符, f/e/g 浮点, s 字符串, p 指针
+ */
+struct Spec {
+  bool zero = false;        // 数值以 0 填充宽度
+  uint32_t width = 0;       // 最小宽度, 数值右对齐, 其余左对齐
+  int32_t precision = -1;   // 浮点精度或字符串最大长度
+  char type = '\0';
+};
+
+/**
+ * 解析格式说明
+ * @param begin ':' 之后的位置
+ * @param end 格式串结束位置
+ * @param spec 解析结果
+ * @return '}' 的位置, 格式错误时返回空
+ */
+constexpr const char* ParseSpec(const char* begin, const char* end, Spec& spec) {
+  auto p = begin;
+  auto digit = [&]{ return p != end && *p >= '0' && *p <= '9'; };
+  if (digit() && *p == '0') {
+    spec.zero = true;
+    ++p;
+  }
+  while (digit()) spec.width = spec.width * 10 + (*p++ - '0');
+  if (p != end && *p == '.') {
+    ++p;
+    if (!digit()) return nullptr;
+    spec.precision = 0;
+    while (digit()) spec.precision = spec.precision * 10 + (*p++ - '0');
+  }
+  if (p != end && *p != '}') spec.type = *p++;
+  if (p == end || *p != '}') return nullptr;
+  return p;
+}
+
+/**
+ * 判断格式说明是否适用于该类别的参数
+ */
+constexpr bool IsValidSpec(KIND kind, const Spec& spec) {
+  if (kind == OTHER) return !spec.zero && !spec.width && spec.precision < 0 && !spec.type;
+  if (spec.precision >= 0 && kind != FLOAT && kind != STRING) return false;
+  switch (spec.type) {
+    case '\0': return true;
+    case 'd': case 'x': case 'X': case 'o': case 'b': return kind == INT || kind == CHAR || kind == BOOL;
+    case 'c': return kind == INT || kind == CHAR;
+    case 'f': case 'e': case 'g': return kind == FLOAT;
+    case 's': return kind == STRING || kind == BOOL;
+    case 'p': return kind == POINTER;
+    default: return false;
+  }
+}
+
+// 以下函数仅声明, 在编译期校验中被调用即产生编译错误, 函数名即错误原因
+void FormatErrorUnmatchedBrace();
+void FormatErrorInvalidSpec();
+void FormatErrorTooFewArguments();
+void FormatErrorTooManyArguments();
+
+/**
+ * 编译期校验的格式串, 占位符数量/格式说明与参数类型不匹配时无法通过编译
+ * @tparam Args 参数类型
+ */
+template <typename... Args>
+class FormatString {
+ public:
+  template <typename S, typename = std::enable_if_t<std::is_convertible_v<const S&, std::string_view> > >
+  consteval FormatString(const S& str)
+      : str_(str) {
+    Check();
+  }
+  constexpr std::string_view get() const {
+    return str_;
+  }
+ private:
+  consteval void Check() const {
+    constexpr KIND kinds[] = {KindOf<Args>()..., OTHER};
+    size_t index = 0;
+    auto end = str_.data() + str_.size();
+    for (auto p = str_.data(); p != end; ++p) {
+      if (*p == '}') {
+        if (p + 1 == end || p[1] != '}') FormatErrorUnmatchedBrace();
+        ++p;
+        continue;
+      }
+      if (*p != '{') continue;
+      if (p + 1 != end && p[1] == '{') {
+        ++p;
+        continue;
+      }
+      Spec spec;
+      if (p + 1 != end && p[1] == ':') {
+        p = ParseSpec(p + 2, end, spec);
+        if (!p) FormatErrorInvalidSpec();
+      } else if (p + 1 != end && p[1] == '}') {
+        ++p;
+      } else {
+        FormatErrorUnmatchedBrace();
+      }
+      if (index >= sizeof...(Args)) FormatErrorTooFewArguments();
+      if (!IsValidSpec(kinds[index], spec)) FormatErrorInvalidSpec();
+      ++index;
+    }
+    if (index != sizeof...(Args)) FormatErrorTooManyArguments();
+  }
+ private:
+  std::string_view str_;
+};
+
+/**
+ * 按宽度填充后追加
+ * @param left 是否左对齐
+ */
+inline void AppendPadded(LogBuffer& buf, std::string_view str, const Spec& spec, bool left) {
+  auto pad = spec.width > str.size() ? spec.width - str.size() : 0;
+  if (!pad) {
+    buf.append(str);
+    return;
+  }
+  auto ptr = buf.Prepare(spec.width);
+  if (left) {
+    memcpy(ptr, str.data(), str.size());
+    memset(ptr + str.size(), ' ', pad);
+  } else if (spec.zero) {
+    // 0 填充位于符号及进制前缀之后
+    size_t prefix = !str.empty() && (str[0] == '-' || str[0] == '+') ? 1 : 0;
+    if (str.size() > prefix + 1 && str[prefix] == '0' && (str[prefix + 1] == 'x' || str[prefix + 1] == 'X')) prefix += 2;
+    memcpy(ptr, str.data(), prefix);
+    memset(ptr + prefix, '0', pad);
+    memcpy(ptr + prefix + pad, str.data() + prefix, str.size() - prefix);
+  } else {
+    memset(ptr, ' ', pad);
+    memcpy(ptr + pad, str.data(), str.size());
+  }
+  buf.Commit(spec.width);
+}
+
+template <typename T>
+void FormatInt(LogBuffer& buf, T value, const Spec& spec) {
+  char str[sizeof(T) * 8 + 2];
+  std::to_chars_result res{};
+  switch (spec.type) {
+    case 'x': case 'X': res = std::to_chars(str, str + sizeof(str), value, 16); break;
+    case 'o': res = std::to_chars(str, str + sizeof(str), value, 8); break;
+    case 'b': res = std::to_chars(str, str + sizeof(str), value, 2); break;
+    default: res = std::to_chars(str, str + sizeof(str), value); break;
+  }
+  if (spec.type == 'X') {
+    for (auto p = str; p != res.ptr; ++p) {
+      if (*p >= 'a' && *p <= 'f') *p -= 'a' - 'A';
+    }
+  }
+  AppendPadded(buf, std::string_view(str, res.ptr - str), spec, false);
+}
+
+template <typename T>
+void FormatFloat(LogBuffer& buf, T value, const Spec& spec) {
+  char str[64];
+  std::to_chars_result res{};
+  if (spec.precision < 0 && !spec.type) {
+    // 默认为最短的可还原表示, 与 std::format 一致
+    res = std::to_chars(str, str + sizeof(str), value);
+  } else {
+    auto precision = spec.precision < 0 ? 6 : spec.precision;
+    auto format = spec.type == 'f' ? std::chars_format::fixed
+                : spec.type == 'e' ? std::chars_format::scientific
+                : std::chars_format::general;
+    res = std::to_chars(str, str + sizeof(str), value, format, precision);
+    if (res.ec != std::errc()) {
+      res = std::to_chars(str, str + sizeof(str), value, std::chars_format::scientific, 6);
+    }
+  }
+  AppendPadded(buf, std::string_view(str, res.ptr - str), spec, false);
+}
+
+template <typename T>
+void FormatValue(LogBuffer& buf, const T& value, const Spec& spec = {});
+
+/**
+ * 经 VAR_PROPERTY_SCOPE 注册属性的结构体, 输出为 {name: value, ...}
+ */
+template <typename T>
+constexpr bool k_reflected = requires { T::__Property; };
+
+template <typename T>
+constexpr bool k_range = requires(const T& t) { t.begin(); t.end(); };
+
+template <typename T>
+void FormatOther(LogBuffer& buf, const T& value) {
+  if constexpr (k_reflected<T>) {
+    buf.push_back('{');
+    bool first = true;
+    std::apply([&](const auto&... meta) {
+      ((buf.append(first ? std::string_view() : std::string_view(", ")),
+        first = false,
+        buf.append(std::string_view(meta.Name)),
+        buf.append(std::string_view(": ")),
+        FormatValue(buf, value.*(meta.Member))), ...);
+    }, T::__Property);
+    buf.push_back('}');
+  } else if constexpr (k_range<T>) {
+    buf.push_back('[');
+    bool first = true;
+    for (auto& i : value) {
+      if (!first) buf.append(std::string_view(", "));
+      first = false;
+      FormatValue(buf, i);
+    }
+    buf.push_back(']');
+  } else {
+    std::ostringstream oss;
+    oss << value;
+    buf.append(oss.str());
+  }
+}
+
+template <typename T>
+void FormatValue(LogBuffer& buf, const T& value, const Spec& spec) {
+  using U = std::decay_t<T>;
+  constexpr auto kind = KindOf<U>();
+  if constexpr (kind == BOOL) {
+    if (spec.type && spec.type != 's') {
+      FormatInt(buf, static_cast<int>(value), spec);
+    } else {
+      AppendPadded(buf, value ? std::string_view("true") : std::string_view("false"), spec, true);
+    }
+  } else if constexpr (kind == CHAR) {
+    if (spec.type && spec.type != 'c') {
+      FormatInt(buf, static_cast<int>(value), spec);
+    } else {
+      char c = static_cast<char>(value);
+      AppendPadded(buf, std::string_view(&c, 1), spec, true);
+    }
+  } else if constexpr (kind == INT) {
+    if (spec.type == 'c') {
+      char c = static_cast<char>(value);
+      AppendPadded(buf, std::string_view(&c, 1), spec, true);
+    } else {
+      FormatInt(buf, value, spec);
+    }
+  } else if constexpr (kind == FLOAT) {
+    FormatFloat(buf, value, spec);
+  } else if constexpr (kind == STRING) {
+    std::string_view str;
+    if constexpr (!std::is_array_v<T> && (std::is_same_v<U, const char*> || std::is_same_v<U, char*>)) {
+      str = value ? std::string_view(value) : std::string_view("(null)");
+    } else {
+      str = std::string_view(value);
+    }
+    if (spec.precision >= 0 && str.size() > static_cast<size_t>(spec.precision)) str = str.substr(0, spec.precision);
+    AppendPadded(buf, str, spec, true);
+  } else if constexpr (kind == POINTER) {
+    char str[2 + sizeof(uintptr_t) * 2] = {'0', 'x'};
+    auto address = reinterpret_cast<uintptr_t>(static_cast<const volatile void*>(value));
+    auto res = std::to_chars(str + 2, str + sizeof(str), address, 16);
+    AppendPadded(buf, std::string_view(str, res.ptr - str), spec, false);
+  } else {
+    FormatOther(buf, value);
+  }
+}
+
+template <typename T>
+void FormatErased(LogBuffer& buf, const void* value, const Spec& spec) {
+  FormatValue(buf, *static_cast<const T*>(value), spec);
+}
+
+/**
+ * 按格式串展开参数并追加, 格式已在编译期校验, 运行时单次遍历
+ * @param buf 目标缓存
+ * @param format 格式串
+ * @param args 参数
+ */
+template <typename... Args>
+void Format(LogBuffer& buf, std::string_view format, const Args&... args) {
+  using Func = void (*)(LogBuffer&, const void*, const Spec&);
+  // 参数按序展开为类型擦除的数组, 避免逐个占位符递归实例化
+  const void* values[] = {static_cast<const void*>(&args)..., nullptr};
+  constexpr Func funcs[] = {&FormatErased<Args>..., nullptr};
+  size_t index = 0;
+  auto end = format.data() + format.size();
+  auto literal = format.data();
+  for (auto p = format.data(); p != end; ++p) {
+    if (*p != '{' && *p != '}') continue;
+    buf.append(literal, p - literal);
+    // "{{" 与 "}}" 输出单个括号
+    if (*p == '}' || p[1] == '{') {
+      literal = ++p;
+      continue;
+    }
+    Spec spec;
+    p = p[1] == ':' ? ParseSpec(p + 2, end, spec) : p + 1;
+    funcs[index](buf, values[index], spec);
+    ++index;
+    literal = p + 1;
+  }
+  buf.append(literal, end - literal);
+}
+
+} // fmt
+
+namespace field {
+
+// 结构化字段编码, 依次存放于消息中, 由输出端按需展开(JSON/文本)
+// field : | key size (4) | key | value |
+// value : | tag (1) | payload |
+//   BOOL (1) / INT, UINT (8) / FLOAT (8) / STR | size (4) | bytes |
+//   OBJECT | field ... | END |
+//   ARRAY  | value ... | END |
+
+/**
+ * 字段值类型
+ */
+enum TAG : uint8_t {
+  NUL = 0,
+  BOOL,
+  INT,
+  UINT,
+  FLOAT,
+  STR,
+  OBJECT,
+  ARRAY,
+  END,
+};
+
+template <typename T>
+inline void Put(std::string& buf, const T& value) {
+  buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void PutStr(std::string& buf, std::string_view str) {
+  Put(buf, static_cast<uint32_t>(str.size()));
+  buf.append(str.data(), str.size());
+}
+
+template <typename T>
+void EncodeValue(std::string& buf, const T& value);
+
+/**
+ * 编码单个字段
+ * @param buf 目标缓存
+ * @param key 字段名
+ * @param value 字段值
+ */
+template <typename T>
+void Encode(std::string& buf, std::string_view key, const T& value) {
+  PutStr(buf, key);
+  EncodeValue(buf, value);
+}
+
+/**
+ * 编码字段值, 反射结构体编码为对象, 容器编码为数组, 其余类型经 std::ostream 转为字符串
+ */
+template <typename T>
+void EncodeValue(std::string& buf, const T& value) {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_same_v<U, bool>) {
+    Put(buf, BOOL);
+    Put(buf, static_cast<uint8_t>(value));
+  } else if constexpr (std::is_same_v<U, char>) {
+    Put(buf, STR);
+    PutStr(buf, std::string_view(&value, 1));
+  } else if constexpr (std::is_enum_v<U>) {
+    EncodeValue(buf, static_cast<std::underlying_type_t<U> >(value));
+  } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+    Put(buf, INT);
+    Put(buf, static_cast<int64_t>(value));
+  } else if constexpr (std::is_integral_v<U>) {
+    Put(buf, UINT);
+    Put(buf, static_cast<uint64_t>(value));
+  } else if constexpr (std::is_floating_point_v<U>) {
+    Put(buf, FLOAT);
+    Put(buf, static_cast<double>(value));
+  } else if constexpr (std::is_null_pointer_v<U>) {
+    Put(buf, NUL);
+  } else if constexpr (!std::is_array_v<T> && (std::is_same_v<U, const char*> || std::is_same_v<U, char*>)) {
+    if (!value) {
+      Put(buf, NUL);
+      return;
+    }
+    Put(buf, STR);
+    PutStr(buf, value);
+  } else if constexpr (std::is_convertible_v<const U&, std::string_view>) {
+    Put(buf, STR);
+    PutStr(buf, std::string_view(value));
+  } else if constexpr (fmt::k_reflected<U>) {
+    Put(buf, OBJECT);
+    std::apply([&](const auto&... meta) {
+      (Encode(buf, meta.Name, value.*(meta.Member)), ...);
+    }, U::__Property);
+    Put(buf, END);
+  } else if constexpr (fmt::k_range<U>) {
+    Put(buf, ARRAY);
+    for (auto& i : value) EncodeValue(buf, i);
+    Put(buf, END);
+  } else {
+    std::ostringstream oss;
+    oss << value;
+    Put(buf, STR);
+    PutStr(buf, oss.str());
+  }
+}
+
+} // field
+
 class Log {
  public:
   /**
    * 构建流式输出
-   * @param file 文件名
-   * @param function 函数名
-   * @param line 行号
-   * @param level 等级
-   * @param name 日志器名
+   * @param site 调用点, 需在消息输出完毕前有效(通常为静态常量)
+   * @param handle 日志器句柄
    */
-  Log(const char* file,
-      const char* function,
-      uint64_t line,
-      level::LEVEL level,
-      const char* name);
+  Log(const CallSite& site, const LoggerHandle& handle);
   /**
-   * 在对象析构时处理缓存的字符串
+   * 在对象析构时将缓存的内容移交日志器
    */
   ~Log();
   /**
@@ -131,6 +1254,38 @@ class Log {
    * @return 标准字符串
    */
   static std::string CStringToStdString(const char* format = nullptr, ...);
+  /**
+   * 以 printf 风格格式化并追加至消息
+   * @param format 输出格式
+   * @param ... 输出的参数
+   * @return 返回自身引用, 可继续以 << 追加
+   */
+  Log& Printf(const char* format, ...) T_LOG_PRINTF_CHECK(2, 3);
+  inline Log& Printf() {
+    return *this;
+  }
+  /**
+   * 以 "{}" 风格格式化并追加至消息, 格式串在编译期校验
+   * @param format 格式串
+   * @param args 参数
+   * @return 返回自身引用
+   */
+  template <typename... Args>
+  Log& Format(fmt::FormatString<std::type_identity_t<Args>...> format, const Args&... args) {
+    fmt::Format(stream_.buffer(), format.get(), args...);
+    return *this;
+  }
+  /**
+   * 附加结构化字段, 由 JSON 输出端按原类型输出, 文本格式以 %k 输出
+   * @param key 字段名
+   * @param value 字段值, 反射结构体输出为嵌套对象
+   * @return 返回自身引用
+   */
+  template <typename T>
+  Log& With(std::string_view key, const T& value) {
+    field::Encode(fields_, key, value);
+    return *this;
+  }
   /**
    * 流输出方式 重写输入运算符
    * @tparam T 模板参数来适应不同类型的参数传递
@@ -139,7 +1294,7 @@ class Log {
    */
   template <typename T>
   Log& operator<<(const T& value) {
-    oss_ << value;
+    stream_ << value;
     return *this;
   }
   /**
@@ -148,19 +1303,242 @@ class Log {
    * @return 返回自身引用
    */
   Log& operator<<(std::ostream& (*func)(std::ostream&)) {
-    oss_ << func;
+    stream_ << func;
     return *this;
   }
+  /**
+   * 用于适配 std::boolalpha, std::hex 等格式标记
+   * @param func 函数指针
+   * @return 返回自身引用
+   */
+  Log& operator<<(std::ios_base& (*func)(std::ios_base&)) {
+    stream_ << func;
+    return *this;
+  }
+
+ private:
+  /**
+   * 原始计数, 输出时才换算为墙上时间
+   */
+  uint64_t time_;
+  const CallSite* site_;
+  LoggerSlot* slot_;
+  /**
+   * 用于存储缓冲字符串, 短消息不分配内存
+   */
+  LogStream stream_;
+  /**
+   * 已编码的结构化字段
+   */
+  std::string fields_;
+};
+
+namespace bin {
+/**
+ * 参数类型标记, 编码格式为 | tag (1 byte) | data |
+ * 字符串 data 为 | size (4 bytes) | bytes |, 其余均为 8 字节
+ */
+enum TAG : uint8_t {
+  I64 = 0,
+  U64,
+  F64,
+  STR,
+  PTR,
+};
+
+template <typename T>
+inline void EncodeRaw(std::string& buf, TAG tag, const T& value) {
+  buf.push_back(static_cast<char>(tag));
+  buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void EncodeStr(std::string& buf, std::string_view str) {
+  EncodeRaw(buf, STR, static_cast<uint32_t>(str.size()));
+  buf.append(str.data(), str.size());
+}
+
+/**
+ * 编码单个参数
+ * @tparam T 参数类型, 支持算术类型/枚举/字符串/指针
+ * @param buf 目标缓存
+ * @param value 参数
+ */
+template <typename T>
+void Encode(std::string& buf, const T& value) {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_enum_v<U>) {
+    EncodeRaw(buf, I64, static_cast<int64_t>(value));
+  } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+    EncodeRaw(buf, I64, static_cast<int64_t>(value));
+  } else if constexpr (std::is_integral_v<U>) {
+    EncodeRaw(buf, U64, static_cast<uint64_t>(value));
+  } else if constexpr (std::is_floating_point_v<U>) {
+    EncodeRaw(buf, F64, static_cast<double>(value));
+  } else if constexpr (!std::is_array_v<T> && (std::is_same_v<U, const char*> || std::is_same_v<U, char*>)) {
+    EncodeStr(buf, value ? std::string_view(value) : std::string_view("(null)"));
+  } else if constexpr (std::is_convertible_v<const U&, std::string_view>) {
+    EncodeStr(buf, std::string_view(value));
+  } else if constexpr (std::is_pointer_v<U>) {
+    EncodeRaw(buf, PTR, reinterpret_cast<uint64_t>(value));
+  } else {
+    static_assert(!sizeof(U), "tools::log::bin => unsupported argument type");
+  }
+}
+
+/**
+ * 提交已编码的参数
+ * @param handle 日志器句柄
+ * @param site 调用点
+ * @param args 已编码参数
+ */
+void Submit(const LoggerHandle& handle, const CallSite& site, std::string&& args);
+
+/**
+ * 二进制日志入口, 仅编码参数, 不做任何格式化
+ * @param handle 日志器句柄
+ * @param site 调用点
+ * @param args 参数
+ */
+template <typename ...Args>
+void Capture(const LoggerHandle& handle, const CallSite& site, const Args&... args) {
+  std::string buf;
+  buf.reserve(sizeof...(Args) * (sizeof(uint64_t) + 1));
+  (Encode(buf, args), ...);
+  Submit(handle, site, std::move(buf));
+}
+
+} // bin
+
+namespace sample {
+
+/**
+ * 单调时钟(纳秒)
+ */
+inline int64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * 调用点采样状态基类, 负责统计被抑制的条数并周期性地输出汇总
+ * 汇总由该调用点之后的某次调用(无论是否被抑制)在周期到达后输出;
+ * 首次抑制时调用点登记至管理器, 之后不再被调用时由其后台线程补充输出到期的汇总
+ */
+class Site {
+ public:
+  /**
+   * 已到期时输出汇总, 由管理器的后台线程周期性调用
+   */
+  inline void Expire(const LoggerHandle& handle, const CallSite& site) {
+    auto due = report_at_.load(std::memory_order_relaxed);
+    if (due && suppressed_.load(std::memory_order_relaxed) && Now() >= due) Poll(handle, site, due);
+  }
+ protected:
+  /**
+   * 允许输出, 有待汇总的条数时检查是否到期
+   */
+  inline bool Pass(const LoggerHandle& handle, const CallSite& site) {
+    if (suppressed_.load(std::memory_order_relaxed)) Check(handle, site);
+    return true;
+  }
+  /**
+   * 抑制输出, 仅累加计数
+   */
+  inline bool Suppress(const LoggerHandle& handle, const CallSite& site) {
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    Check(handle, site);
+    return false;
+  }
+ private:
+  inline void Check(const LoggerHandle& handle, const CallSite& site) {
+    auto due = report_at_.load(std::memory_order_relaxed);
+    if (due && Now() < due) return;
+    Poll(handle, site, due);
+  }
+  /**
+   * 未计划时计划下一次汇总, 已到期时由竞争成功的线程输出汇总
+   * @param due 当前计划的汇总时间, 0 为未计划
+   */
+  void Poll(const LoggerHandle& handle, const CallSite& site, int64_t due);
+ private:
+  std::atomic<uint64_t> suppressed_{0};
+  std::atomic<int64_t> report_at_{0};
+  std::atomic<bool> watched_{false};
+};
 
+/**
+ * 每 N 次输出一次
+ */
+class EveryN : public Site {
+ public:
+  inline bool Allow(const LoggerHandle& handle, const CallSite& site, uint64_t n) {
+    auto count = count_.fetch_add(1, std::memory_order_relaxed);
+    return n <= 1 || count % n == 0 ? Pass(handle, site) : Suppress(handle, site);
+  }
  private:
+  std::atomic<uint64_t> count_{0};
+};
+
+/**
+ * 仅输出前 N 次, 达到次数后不再修改计数
+ */
+class FirstN : public Site {
+ public:
+  inline bool Allow(const LoggerHandle& handle, const CallSite& site, uint64_t n) {
+    if (count_.load(std::memory_order_relaxed) < n &&
+        count_.fetch_add(1, std::memory_order_relaxed) < n) {
+      return Pass(handle, site);
+    }
+    return Suppress(handle, site);
+  }
+ private:
+  std::atomic<uint64_t> count_{0};
+};
+
+/**
+ * 每个时间间隔最多输出一次
+ */
+class EveryT : public Site {
+ public:
+  inline bool Allow(const LoggerHandle& handle, const CallSite& site, uint32_t ms) {
+    auto now = Now();
+    auto next = next_.load(std::memory_order_relaxed);
+    if (now >= next && next_.compare_exchange_strong(next, now + static_cast<int64_t>(ms) * 1000000,
+                                                     std::memory_order_relaxed)) {
+      return Pass(handle, site);
+    }
+    return Suppress(handle, site);
+  }
+ private:
+  std::atomic<int64_t> next_{0};
+};
+
+/**
+ * 令牌桶限流, 以 GCRA 实现: 仅保存理论到达时间, 单个原子变量即可完成补充与扣减
+ */
+class RateLimited : public Site {
+ public:
   /**
-   * 用于存储缓冲字符串
+   * @param rate 每秒补充的令牌数
+   * @param burst 桶容量, 即允许的突发条数
    */
-  std::ostringstream oss_;
-  class Impl;
-  std::unique_ptr<Impl> impl_;
+  inline bool Allow(const LoggerHandle& handle, const CallSite& site, double rate, uint32_t burst) {
+    if (rate <= 0) return Suppress(handle, site);
+    auto interval = static_cast<int64_t>(1e9 / rate);
+    auto tolerance = interval * (burst > 1 ? burst - 1 : 0);
+    auto now = Now();
+    auto tat = tat_.load(std::memory_order_relaxed);
+    do {
+      if (now < tat - tolerance) return Suppress(handle, site);
+    } while (!tat_.compare_exchange_weak(tat, std::max(tat, now) + interval, std::memory_order_relaxed));
+    return Pass(handle, site);
+  }
+ private:
+  std::atomic<int64_t> tat_{0};
 };
 
+} // sample
+
 } // log
 } // tools
 
@@ -0,0 +1,101 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 20:12:37
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 20:12:37
+ * @Description: 低开销时钟, 热路径仅读取原始计数(TSC), 需要墙上时间时再按校准结果换算
+ */
+
+#ifndef TICK_H_
+#define TICK_H_
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TOOLS_TICK_TSC      1
+#if _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define TOOLS_TICK_TSC      0
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace tools {
+namespace tick {
+
+/**
+ * 计数来源
+ */
+namespace source {
+enum TYPE : uint8_t {
+  UNKNOWN = 0,
+  TSC,      // CPU 时间戳计数器, 仅在支持 invariant TSC(频率恒定且各核同步)时使用
+  STEADY,   // 单调时钟(纳秒)
+};
+} // source
+
+namespace detail {
+
+/**
+ * 当前的计数来源, 常量初始化, 不受静态对象初始化顺序影响
+ */
+extern std::atomic<uint8_t> g_source;
+
+/**
+ * 检测计数来源并取得基准采样, 仅首次调用时执行
+ */
+source::TYPE Init();
+
+inline uint64_t Steady() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // detail
+
+/**
+ * 读取原始计数, 仅用于同一进程内比较先后或经 ToNanos 换算, 不可跨进程传递
+ * @return 计数
+ */
+inline uint64_t Now() {
+  auto type = detail::g_source.load(std::memory_order_relaxed);
+  if (type == source::UNKNOWN) type = detail::Init();
+#if TOOLS_TICK_TSC
+  if (type == source::TSC) return __rdtsc();
+#endif
+  return detail::Steady();
+}
+
+/**
+ * 将计数换算为墙上时间, 距上次校准超过 1 秒时由调用线程重新校准
+ * 首次换算不等待, 以启动至今的间隔估算频率, 1ms 后的换算再精确校准
+ * 校准偏差平滑修正, 换算结果随计数单调递增; 墙上时间被调整超过 128ms 时随之跳变
+ * 不加锁/不分配内存, 可在信号处理函数中调用
+ * @param ticks Now() 的返回值
+ * @return 自 1970-01-01 起的纳秒数
+ */
+int64_t ToNanos(uint64_t ticks);
+
+inline std::chrono::system_clock::time_point ToSystem(uint64_t ticks) {
+  return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      std::chrono::nanoseconds(ToNanos(ticks))));
+}
+
+/**
+ * 当前的计数来源
+ */
+source::TYPE Source();
+
+/**
+ * 当前校准的计数频率(每秒计数), 单调时钟为 1e9
+ */
+double Frequency();
+
+} // tick
+} // tools
+
+#endif // TICK_H_
@@ -8,11 +8,13 @@
 
 #include "log.h"
 
-#include <ctime>
+#include <cmath>
+#include <chrono>
 #include <cstdarg>
-#include <iostream>
 #include <vector>
+#include <algorithm>
 
+#include "log/crash.h"
 #include "log/logger.h"
 
 namespace tools {
@@ -26,6 +28,10 @@ level::LEVEL GetLevel() {
   return Mgr::GetInstance().level();
 }
 
+bool SetLevel(const std::string& name, level::LEVEL level) {
+  return Mgr::GetInstance().SetLevel(name, level >= level::NUM_LEVEL ? level::INFO : level);
+}
+
 bool RegisterLogger(const std::string& name) {
   return Mgr::GetInstance().Register(name);
 }
@@ -42,42 +48,93 @@ std::vector<std::weak_ptr<Config> > GetAllLoggers() {
   return Mgr::GetInstance().GetAllLoggers();
 }
 
-class Log::Impl {
- public:
-  inline Impl(time_t time,
-       const char *file,
-       const char *function,
-       uint64_t line,
-       level::LEVEL level,
-       const char *name)
-    : name_(name),
-      msg_(new Msg{time, file, function, line, level, ""}) {}
-  inline ~Impl() {
-    Mgr::GetInstance().Output(name_, std::move(msg_));
+bool EnableAsync(const AsyncConfig& cfg) {
+  return Mgr::GetInstance().EnableAsync(cfg);
+}
+
+void DisableAsync() {
+  Mgr::GetInstance().DisableAsync();
+}
+
+void Flush() {
+  Mgr::GetInstance().Flush();
+}
+
+namespace sample {
+namespace {
+std::atomic<int64_t> g_report_interval{10LL * 1000000000};
+} // namespace
+
+void Site::Poll(const LoggerHandle& handle, const CallSite& site, int64_t due) {
+  if (!due) {
+    // 首次抑制时开始计时
+    report_at_.compare_exchange_strong(due, Now() + g_report_interval.load(std::memory_order_relaxed),
+                                       std::memory_order_relaxed);
+    // 调用点之后可能不再被调用, 登记后由后台线程输出最后的汇总
+    if (!watched_.exchange(true, std::memory_order_relaxed)) Mgr::GetInstance().Watch(this, &site, handle.slot());
+    return;
   }
-  inline void UpdateContent(const std::ostringstream& oss) {
-    msg_->content = std::move(oss.str());
+  if (!report_at_.compare_exchange_strong(due, 0, std::memory_order_relaxed)) return;
+  auto count = suppressed_.exchange(0, std::memory_order_relaxed);
+  if (!count) return;
+  Log(site, handle).With("suppressed", count)
+      << "suppressed " << count << " messages\n";
+}
+
+} // sample
+
+Stats GetStats() {
+  return Mgr::GetInstance().GetStats();
+}
+
+void SetStatsReportInterval(uint32_t ms) {
+  Mgr::GetInstance().SetStatsReportInterval(ms);
+}
+
+bool InstallCrashHandler() {
+  return crash::Install();
+}
+
+bool InstallCrashStack() {
+  return crash::InstallThreadStack();
+}
+
+double Histogram::Mean() const {
+  return count ? static_cast<double>(sum) / count : 0;
+}
+
+uint64_t Histogram::Percentile(double p) const {
+  if (!count) return 0;
+  auto target = static_cast<uint64_t>(std::ceil(count * std::clamp(p, 0.0, 100.0) / 100));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < k_buckets; i++) {
+    seen += buckets[i];
+    if (seen >= target && seen) {
+      // 第 i 个桶的上界为 2^i - 1, 最后一个桶无上界
+      if (i + 1 == k_buckets) return max;
+      return std::min((uint64_t(1) << i) - 1, max);
+    }
   }
- private:
-  /**
-   * 日志器名
-   */
-  const char* name_;
-  /**
-   * 消息体
-   */
-  std::shared_ptr<Msg> msg_;
-};
-
-Log::Log(const char* file,
-         const char* function,
-         uint64_t line,
-         level::LEVEL level,
-         const char* name)
-    : impl_(new Impl(std::time(nullptr), file, function, line, level, name)) {}
+  return max;
+}
+
+void SetSuppressReportInterval(uint32_t ms) {
+  sample::g_report_interval.store(static_cast<int64_t>(ms) * 1000000, std::memory_order_relaxed);
+}
+
+LoggerHandle::LoggerHandle(const std::string& name)
+    : slot_(Mgr::GetInstance().Slot(name)),
+      level_(&slot_->level) {}
+
+Log::Log(const CallSite& site, const LoggerHandle& handle)
+    : time_(tick::Now()),
+      site_(&site),
+      slot_(handle.slot()) {}
 
 Log::~Log() {
-  impl_->UpdateContent(oss_);
+  // 缓存直接移入消息, 堆上的内容不再拷贝
+  Msg msg{time_, site_, site_->level, std::move(stream_.buffer()), {}, std::move(fields_)};
+  Mgr::GetInstance().Output(slot_, msg);
 }
 
 std::string Log::CStringToStdString(const char *format, ...) {
@@ -87,8 +144,16 @@ std::string Log::CStringToStdString(const char *format, ...) {
   }
   va_list args;
   va_start(args, format);
+  // va_list 被 vsnprintf 消耗后不可再次使用, 计算长度时使用其副本
+  va_list copy;
+  va_copy(copy, args);
   // 通过 vsnprintf 计算出所需的字符串长度
-  auto len = vsnprintf(nullptr, 0, format, args);
+  auto len = vsnprintf(nullptr, 0, format, copy);
+  va_end(copy);
+  if (len < 0) {
+    va_end(args);
+    return "";
+  }
   // 使用 vector 创建 buffer, 并初始化为 0
   std::vector<char> buf(len + 1, 0);
   // 使用 vsnprintf 填入到目标 buffer 内
@@ -97,5 +162,34 @@ std::string Log::CStringToStdString(const char *format, ...) {
   return buf.data();
 }
 
+Log& Log::Printf(const char* format, ...) {
+  if (!format) return *this;
+  auto& buf = stream_.buffer();
+  va_list args;
+  va_start(args, format);
+  va_list copy;
+  va_copy(copy, args);
+  // 先直接写入缓存剩余空间, 仅在空间不足时扩容后再格式化一次
+  auto spare = buf.capacity() - buf.size();
+  auto len = vsnprintf(buf.Prepare(0), spare, format, copy);
+  va_end(copy);
+  if (len >= 0 && static_cast<size_t>(len) >= spare) {
+    auto ptr = buf.Prepare(len + 1);
+    vsnprintf(ptr, len + 1, format, args);
+  }
+  va_end(args);
+  if (len > 0) buf.Commit(len);
+  return *this;
+}
+
+namespace bin {
+
+void Submit(const LoggerHandle& handle, const CallSite& site, std::string&& args) {
+  Msg msg{tick::Now(), &site, site.level, {}, std::move(args)};
+  Mgr::GetInstance().Output(handle.slot(), msg);
+}
+
+} // bin
+
 } // log
 } // tools
\ No newline at end of file
@@ -0,0 +1,340 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 13:20:07
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 13:20:07
+ * @Description:
+ */
+
+#include "binary.h"
+
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+
+#include "logger.h"
+
+namespace tools {
+namespace log {
+namespace bin {
+namespace {
+
+/**
+ * 解码后的单个参数
+ */
+struct Arg {
+  TAG tag;
+  union {
+    int64_t i;
+    uint64_t u;
+    double f;
+  };
+  const char* str;
+  uint32_t len;
+};
+
+/**
+ * 依次读取已编码参数
+ */
+class ArgReader {
+ public:
+  explicit ArgReader(const std::string& args)
+      : data_(args.data()), size_(args.size()) {}
+  bool Next(Arg& arg) {
+    if (offset_ + 1 > size_) return false;
+    arg.tag = static_cast<TAG>(data_[offset_++]);
+    if (arg.tag == STR) {
+      if (offset_ + sizeof(uint32_t) > size_) return false;
+      memcpy(&arg.len, data_ + offset_, sizeof(uint32_t));
+      offset_ += sizeof(uint32_t);
+      if (offset_ + arg.len > size_) return false;
+      arg.str = data_ + offset_;
+      offset_ += arg.len;
+      return true;
+    }
+    if (offset_ + sizeof(uint64_t) > size_) return false;
+    memcpy(&arg.u, data_ + offset_, sizeof(uint64_t));
+    offset_ += sizeof(uint64_t);
+    return true;
+  }
+ private:
+  const char* data_;
+  size_t size_;
+  size_t offset_ = 0;
+};
+
+inline int64_t AsInt(const Arg& arg) {
+  switch (arg.tag) {
+    case F64: return static_cast<int64_t>(arg.f);
+    case STR: return 0;
+    default: return arg.i;
+  }
+}
+
+inline double AsDouble(const Arg& arg) {
+  switch (arg.tag) {
+    case I64: return static_cast<double>(arg.i);
+    case F64: return arg.f;
+    case STR: return 0;
+    default: return static_cast<double>(arg.u);
+  }
+}
+
+/**
+ * 以 snprintf 格式化单个值并追加
+ */
+template <typename T>
+void Append(std::string& out, const char* spec, T value) {
+  char buffer[128];
+  auto n = snprintf(buffer, sizeof(buffer), spec, value);
+  if (n < 0) return;
+  if (static_cast<size_t>(n) < sizeof(buffer)) {
+    out.append(buffer, n);
+    return;
+  }
+  auto old = out.size();
+  out.resize(old + n);
+  snprintf(&out[old], n + 1, spec, value);
+}
+
+template <typename T>
+bool Get(std::istream& is, T& value) {
+  return static_cast<bool>(is.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+bool GetStr(std::istream& is, std::string& str) {
+  uint32_t size;
+  if (!Get(is, size)) return false;
+  str.resize(size);
+  return static_cast<bool>(is.read(str.data(), size));
+}
+
+} // namespace
+
+void Render(const char* format, const std::string& args, std::string& out) {
+  if (!format) return;
+  ArgReader reader(args);
+  // 转换说明, 长度修饰符会被替换为与解码类型一致的修饰符
+  char spec[48];
+  for (const char* p = format; *p; ++p) {
+    if (*p != '%') {
+      out.push_back(*p);
+      continue;
+    }
+    if (p[1] == '%') {
+      out.push_back('%');
+      ++p;
+      continue;
+    }
+    const char* start = p++;
+    size_t n = 0;
+    spec[n++] = '%';
+    // flags
+    while (*p && std::strchr("-+ #0", *p) && n < 8) spec[n++] = *p++;
+    // width / precision, '*' 从参数中读取
+    for (int part = 0; part < 2; part++) {
+      if (part == 1) {
+        if (*p != '.') break;
+        spec[n++] = *p++;
+      }
+      if (*p == '*') {
+        Arg arg{};
+        auto value = reader.Next(arg) ? AsInt(arg) : 0;
+        auto res = std::to_chars(spec + n, spec + n + 10, static_cast<int32_t>(value));
+        n = res.ptr - spec;
+        ++p;
+      } else {
+        while (*p >= '0' && *p <= '9' && n < 24) spec[n++] = *p++;
+      }
+    }
+    // 忽略原有长度修饰符
+    while (*p && std::strchr("hljztLq", *p)) ++p;
+    if (!*p) {
+      out.append(start);
+      break;
+    }
+    auto conv = *p;
+    Arg arg{};
+    if (!reader.Next(arg)) {
+      out.append(start, p - start + 1);
+      continue;
+    }
+    if (conv == 'n') continue;
+    switch (conv) {
+      case 'd':
+      case 'i':
+        memcpy(spec + n, "lld", 4);
+        Append(out, spec, static_cast<long long>(AsInt(arg)));
+        break;
+      case 'u':
+      case 'o':
+      case 'x':
+      case 'X':
+        spec[n++] = 'l';
+        spec[n++] = 'l';
+        spec[n++] = conv;
+        spec[n] = '\0';
+        Append(out, spec, static_cast<unsigned long long>(AsInt(arg)));
+        break;
+      case 'c':
+        spec[n++] = 'c';
+        spec[n] = '\0';
+        Append(out, spec, static_cast<int>(AsInt(arg)));
+        break;
+      case 'p':
+        spec[n++] = 'p';
+        spec[n] = '\0';
+        Append(out, spec, reinterpret_cast<void*>(arg.u));
+        break;
+      case 's':
+        if (arg.tag == STR) {
+          // 参数不以 '\0' 结尾, 无精度时直接追加
+          if (n == 1) {
+            out.append(arg.str, arg.len);
+          } else {
+            std::string str(arg.str, arg.len);
+            spec[n++] = 's';
+            spec[n] = '\0';
+            Append(out, spec, str.c_str());
+          }
+        } else if (arg.tag == F64) {
+          Append(out, "%g", arg.f);
+        } else if (arg.tag == U64 || arg.tag == PTR) {
+          Append(out, "%llu", static_cast<unsigned long long>(arg.u));
+        } else {
+          Append(out, "%lld", static_cast<long long>(arg.i));
+        }
+        break;
+      default:
+        // e E f F g G a A
+        spec[n++] = conv;
+        spec[n] = '\0';
+        Append(out, spec, AsDouble(arg));
+        break;
+    }
+  }
+}
+
+void EncodeHeader(const std::string& pattern, std::string& out) {
+  out.append(k_magic, sizeof(k_magic) - 1);
+  Put(out, k_version);
+  PutStr(out, pattern);
+}
+
+uint32_t Encoder::Site(const CallSite* site, std::string& out) {
+  auto res = sites_.find(site);
+  if (res != sites_.end()) return res->second;
+  auto id = static_cast<uint32_t>(sites_.size());
+  sites_.insert({site, id});
+  Put(out, SITE);
+  Put(out, id);
+  Put(out, static_cast<uint8_t>(site->level));
+  Put(out, site->line);
+  PutStr(out, site->format ? site->format : "");
+  PutStr(out, site->file);
+  PutStr(out, site->func);
+  return id;
+}
+
+void Encoder::operator()(const Msg& msg, std::string& out) {
+  // 原始计数仅在本进程内有意义, 写入文件前换算为墙上时间
+  auto time = msg.nanos();
+  auto id = Site(msg.site, out);
+  if (!msg.deferred()) {
+    Put(out, TEXT);
+    Put(out, id);
+    Put(out, time);
+    PutStr(out, msg.content);
+    return;
+  }
+  Put(out, EVENT);
+  Put(out, id);
+  Put(out, time);
+  PutStr(out, msg.args);
+}
+
+/**
+ * 文件中解析出的调用点, 字符串由读取器持有
+ */
+struct Reader::Site {
+  std::string format;
+  std::string file;
+  std::string func;
+  CallSite site;
+};
+
+Reader::Reader() = default;
+
+Reader::~Reader() = default;
+
+bool Reader::Open(const std::string& path) {
+  ifs_.open(path, std::ios::binary | std::ios::in);
+  if (!ifs_.is_open()) return false;
+  char magic[sizeof(k_magic) - 1];
+  uint32_t version;
+  if (!ifs_.read(magic, sizeof(magic)) || memcmp(magic, k_magic, sizeof(magic)) != 0) {
+    return false;
+  }
+  if (!Get(ifs_, version) || version != k_version) return false;
+  return GetStr(ifs_, pattern_);
+}
+
+bool Reader::Next(Msg& msg) {
+  uint8_t type;
+  while (Get(ifs_, type)) {
+    int64_t time;
+    switch (type) {
+      case SITE: {
+        uint32_t id;
+        uint8_t level;
+        auto site = std::make_unique<Site>();
+        if (!Get(ifs_, id) || !Get(ifs_, level) || !Get(ifs_, site->site.line) ||
+            !GetStr(ifs_, site->format) || !GetStr(ifs_, site->file) || !GetStr(ifs_, site->func)) {
+          return false;
+        }
+        site->site.level = static_cast<level::LEVEL>(level);
+        site->site.format = site->format.c_str();
+        site->site.file = site->file.c_str();
+        site->site.base = BaseName(site->site.file);
+        site->site.func = site->func.c_str();
+        sites_[id] = std::move(site);
+        break;
+      }
+      case EVENT: {
+        uint32_t id;
+        if (!Get(ifs_, id) || !Get(ifs_, time) || !GetStr(ifs_, args_)) return false;
+        auto res = sites_.find(id);
+        if (res == sites_.end()) return false;
+        auto& site = res->second->site;
+        msg.time = static_cast<uint64_t>(time);
+        msg.wall = true;
+        msg.level = site.level;
+        msg.site = &site;
+        content_.clear();
+        Render(site.format, args_, content_);
+        msg.content = content_;
+        return true;
+      }
+      case TEXT: {
+        uint32_t id;
+        if (!Get(ifs_, id) || !Get(ifs_, time) || !GetStr(ifs_, content_)) return false;
+        auto res = sites_.find(id);
+        if (res == sites_.end()) return false;
+        auto& site = res->second->site;
+        msg.content = content_;
+        msg.time = static_cast<uint64_t>(time);
+        msg.wall = true;
+        msg.level = site.level;
+        msg.site = &site;
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+} // bin
+} // log
+} // tools
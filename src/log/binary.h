@@ -0,0 +1,134 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 13:20:07
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 13:20:07
+ * @Description:
+ */
+
+#ifndef TOOLS_LOG_BINARY_H_
+#define TOOLS_LOG_BINARY_H_
+
+#include <memory>
+#include <string>
+#include <fstream>
+#include <unordered_map>
+
+#include "log.h"
+
+namespace tools {
+namespace log {
+
+struct Msg;
+
+namespace bin {
+
+// 二进制日志文件结构
+// +------------------+------------------+-----------------+
+// | magic (8 bytes)  | version (4 bytes)| pattern (str)   |  文件头
+// +------------------+------------------+-----------------+
+// | type (1 byte)    |            record body             |  记录 ...
+// +------------------+------------------------------------+
+//
+// SITE  : | id (4) | level (1) | line (4) | format (str) | file (str) | func (str) |
+// EVENT : | site id (4) | time ns (8) | args size (4) | args |
+// TEXT  : | site id (4) | time ns (8) | content (str) |
+// str   : | size (4) | bytes |
+// 所有记录均以 id 引用调用点, 非二进制日志调用点的 format 为空
+
+constexpr char k_magic[] = "TLOGBIN1";
+constexpr uint32_t k_version = 2;
+
+/**
+ * 记录类型
+ */
+enum RECORD : uint8_t {
+  SITE = 1,       // 调用点描述, 每个调用点在文件中仅出现一次
+  EVENT,          // 延迟格式化的消息
+  TEXT,           // 已格式化内容的普通消息
+};
+
+template <typename T>
+inline void Put(std::string& buf, const T& value) {
+  buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void PutStr(std::string& buf, std::string_view str) {
+  Put(buf, static_cast<uint32_t>(str.size()));
+  buf.append(str.data(), str.size());
+}
+
+/**
+ * 按 printf 风格格式展开已编码的参数, 结果追加至 out
+ * 参数类型与转换符不一致时按转换符进行转换, 参数不足时原样输出转换说明
+ * @param format 格式
+ * @param args 已编码参数
+ * @param out 输出缓存
+ */
+void Render(const char* format, const std::string& args, std::string& out);
+
+/**
+ * 文件头
+ * @param pattern 日志器格式, 供解码时默认使用
+ * @param out 输出缓存
+ */
+void EncodeHeader(const std::string& pattern, std::string& out);
+
+/**
+ * 编码单条消息, 调用点首次出现时在记录前追加其描述
+ */
+class Encoder {
+ public:
+  /**
+   * @param msg 消息
+   * @param out 输出缓存
+   */
+  void operator()(const Msg& msg, std::string& out);
+ private:
+  /**
+   * 调用点首次出现时写入其描述
+   * @return 调用点 id
+   */
+  uint32_t Site(const CallSite* site, std::string& out);
+  std::unordered_map<const CallSite*, uint32_t> sites_;
+};
+
+/**
+ * 二进制日志读取器, 解码后的消息可直接交由 Formatter 格式化
+ */
+class Reader {
+ public:
+  Reader();
+  ~Reader();
+  /**
+   * 打开文件并校验文件头
+   * @param path 文件路径
+   * @return 是否成功
+   */
+  bool Open(const std::string& path);
+  /**
+   * 读取下一条消息, 消息中的字符串指针在下一次调用前有效
+   * @param msg 目标消息
+   * @return 文件结束或记录不完整时返回 false
+   */
+  bool Next(Msg& msg);
+  /**
+   * 文件头中记录的日志器格式
+   */
+  inline const std::string& pattern() const {
+    return pattern_;
+  }
+ private:
+  struct Site;
+  std::ifstream ifs_;
+  std::string pattern_;
+  std::unordered_map<uint32_t, std::unique_ptr<Site> > sites_;
+  std::string args_;
+  std::string content_;
+};
+
+} // bin
+} // log
+} // tools
+
+#endif //TOOLS_LOG_BINARY_H_
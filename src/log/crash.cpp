@@ -0,0 +1,262 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 17:40:26
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 17:40:26
+ * @Description:
+ */
+
+#include "crash.h"
+
+#if _WIN32
+#include <io.h>
+#elif __unix__
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <memory>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <algorithm>
+
+#include "logger.h"
+
+namespace tools {
+namespace log {
+namespace crash {
+namespace {
+
+/**
+ * 每个阶段最多注册的对象数
+ */
+constexpr size_t k_max_items = 256;
+
+/**
+ * 紧急缓存大小, 单行消息超出时截断
+ */
+constexpr size_t k_emergency_size = 16 * 1024;
+
+std::atomic<Drainable*> g_items[NUM_STAGE][k_max_items];
+
+/**
+ * 预分配的紧急缓存, 仅在崩溃时由单个线程使用
+ */
+char g_emergency[k_emergency_size];
+
+constexpr int k_signals[] = {SIGSEGV, SIGABRT, SIGFPE, SIGILL,
+#if __unix__
+                             SIGBUS,
+#endif
+};
+
+void WriteRaw(int fd, const char* data, size_t size) {
+  while (size > 0) {
+#if _WIN32
+    auto n = _write(fd, data, static_cast<unsigned int>(size));
+#elif __unix__
+    auto n = write(fd, data, size);
+    if (n < 0 && errno == EINTR) continue;
+#endif
+    if (n <= 0) return;
+    data += n;
+    size -= n;
+  }
+}
+
+/**
+ * 向定长缓存追加, 超出时截断
+ */
+class Appender {
+ public:
+  Appender(char* data, size_t capacity)
+      : data_(data), capacity_(capacity) {}
+  Appender& Append(std::string_view str) {
+    auto n = std::min(str.size(), capacity_ - size_);
+    memcpy(data_ + size_, str.data(), n);
+    size_ += n;
+    return *this;
+  }
+  Appender& Append(uint64_t value, int width = 0) {
+    char buffer[20];
+    int n = 0;
+    do {
+      buffer[n++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value || n < width);
+    while (n > 0 && size_ < capacity_) data_[size_++] = buffer[--n];
+    return *this;
+  }
+  inline std::string_view str() const {
+    return {data_, size_};
+  }
+  /**
+   * 保证以换行结尾, 缓存已满时覆盖最后一个字符
+   */
+  void EndLine() {
+    if (size_ && data_[size_ - 1] == '\n') return;
+    if (size_ == capacity_) --size_;
+    data_[size_++] = '\n';
+  }
+ private:
+  char* data_;
+  size_t capacity_;
+  size_t size_ = 0;
+};
+
+const char* LevelName(level::LEVEL level) {
+  switch (level) {
+#define XX(LVL) \
+    case level::LVL: return #LVL;
+
+    XX(DEBUG)
+    XX(INFO)
+    XX(WARN)
+    XX(ERROR)
+    XX(FATAL)
+#undef XX
+    default: return "UNKNOWN";
+  }
+}
+
+const char* SignalName(int sig) {
+  switch (sig) {
+    case SIGSEGV: return "SIGSEGV";
+    case SIGABRT: return "SIGABRT";
+    case SIGFPE: return "SIGFPE";
+    case SIGILL: return "SIGILL";
+#if __unix__
+    case SIGBUS: return "SIGBUS";
+#endif
+    default: return "SIGNAL";
+  }
+}
+
+void OnSignal(int sig) {
+  static std::atomic<bool> entered{false};
+  if (!entered.exchange(true)) {
+    char buffer[128];
+    Appender header(buffer, sizeof(buffer));
+    header.Append("*** ").Append(SignalName(sig)).Append(" received, draining logs ***\n");
+    WriteRaw(2, header.str().data(), header.str().size());
+    DrainAll();
+  }
+  // 恢复默认处理并重新触发, 保留原有的退出码及 core dump
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+#if __unix__
+/**
+ * 每个线程备用信号栈的大小
+ */
+constexpr size_t k_alt_stack_size = 64 * 1024;
+
+/**
+ * 线程的备用信号栈, 线程退出时先停用再释放
+ */
+struct ThreadStack {
+  std::unique_ptr<char[]> data;
+  ~ThreadStack() {
+    if (!data) return;
+    stack_t stack{};
+    stack.ss_flags = SS_DISABLE;
+    sigaltstack(&stack, nullptr);
+  }
+};
+
+thread_local ThreadStack t_stack;
+
+void OnSignalAction(int sig, siginfo_t*, void*) {
+  OnSignal(sig);
+}
+#endif
+
+} // namespace
+
+void Register(Drainable* item, STAGE stage) {
+  for (auto& i : g_items[stage]) {
+    Drainable* empty = nullptr;
+    if (i.compare_exchange_strong(empty, item, std::memory_order_acq_rel)) return;
+  }
+}
+
+void Unregister(Drainable* item, STAGE stage) {
+  for (auto& i : g_items[stage]) {
+    Drainable* expected = item;
+    if (i.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) return;
+  }
+}
+
+void DrainAll() {
+  for (auto& stage : g_items) {
+    for (auto& i : stage) {
+      if (auto item = i.load(std::memory_order_acquire)) item->Halt();
+    }
+  }
+  for (auto& stage : g_items) {
+    for (auto& i : stage) {
+      if (auto item = i.load(std::memory_order_acquire)) item->Drain();
+    }
+  }
+  for (auto& i : g_items[SINK]) {
+    if (auto item = i.load(std::memory_order_acquire)) item->Sync();
+  }
+}
+
+std::string_view FormatLine(const Msg& msg) {
+  Appender line(g_emergency, sizeof(g_emergency));
+  line.Append(k_mark);
+  auto us = msg.nanos() / 1000;
+  line.Append(static_cast<uint64_t>(us / 1000000)).Append(".").Append(static_cast<uint64_t>(us % 1000000), 6);
+  line.Append(" [").Append(LevelName(msg.level)).Append("] (").Append(msg.site->base)
+      .Append(":").Append(msg.site->line).Append(") ");
+  if (msg.deferred()) {
+    // 二进制日志的参数无法在此展开, 仅输出格式
+    line.Append(msg.site->format ? msg.site->format : "").Append(" [args not rendered]");
+  } else {
+    line.Append(msg.content);
+  }
+  line.EndLine();
+  return line.str();
+}
+
+bool Install() {
+#if __unix__
+  InstallThreadStack();
+  struct sigaction action{};
+  action.sa_sigaction = &OnSignalAction;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESETHAND;
+  sigemptyset(&action.sa_mask);
+  for (auto sig : k_signals) {
+    if (sigaction(sig, &action, nullptr) != 0) return false;
+  }
+  return true;
+#else
+  for (auto sig : k_signals) {
+    if (signal(sig, &OnSignal) == SIG_ERR) return false;
+  }
+  return true;
+#endif
+}
+
+bool InstallThreadStack() {
+#if __unix__
+  stack_t current{};
+  if (sigaltstack(nullptr, &current) == 0 && !(current.ss_flags & SS_DISABLE)) return true;
+  t_stack.data.reset(new char[k_alt_stack_size]);
+  stack_t stack{};
+  stack.ss_sp = t_stack.data.get();
+  stack.ss_size = k_alt_stack_size;
+  if (sigaltstack(&stack, nullptr) == 0) return true;
+  t_stack.data.reset();
+  return false;
+#else
+  return false;
+#endif
+}
+
+} // crash
+} // log
+} // tools
@@ -0,0 +1,99 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 17:40:26
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 17:40:26
+ * @Description: 崩溃时同步排空日志缓存, 信号处理函数中仅调用异步信号安全的函数
+ */
+
+#ifndef TOOLS_LOG_CRASH_H_
+#define TOOLS_LOG_CRASH_H_
+
+#include <cstdint>
+#include <string_view>
+
+namespace tools {
+namespace log {
+
+struct Msg;
+
+namespace crash {
+
+/**
+ * 排空阶段, 先写出输出端缓存(较早的内容), 再写出异步队列中的消息, 最后统一落盘
+ */
+enum STAGE : uint8_t {
+  SINK = 0,
+  QUEUE,
+  NUM_STAGE,
+};
+
+/**
+ * 崩溃时可排空的对象, 实现中不可加锁/分配内存, 仅可调用 write/fsync 等异步信号安全的函数
+ */
+class Drainable {
+ public:
+  virtual ~Drainable() = default;
+  /**
+   * 停止后台线程继续写出, 避免与排空并发, 在所有对象排空前调用
+   */
+  virtual void Halt() {}
+  /**
+   * 写出缓存中尚未写出的内容
+   */
+  virtual void Drain() {}
+  /**
+   * 落盘
+   */
+  virtual void Sync() {}
+};
+
+/**
+ * 注册可排空对象, 超出容量时忽略
+ * @param item 对象
+ * @param stage 所属阶段
+ */
+void Register(Drainable* item, STAGE stage);
+
+/**
+ * 反注册, 需在对象析构前调用
+ */
+void Unregister(Drainable* item, STAGE stage);
+
+/**
+ * 停止所有已注册对象的后台写出后按阶段排空, 仅在崩溃时调用, 不可重入
+ */
+void DrainAll();
+
+/**
+ * 紧急格式行的前缀, 用于与日志器格式的行区分
+ */
+constexpr std::string_view k_mark = "!CRASH ";
+
+/**
+ * 在预分配的紧急缓存中将消息格式化为单行, 不分配内存, 超出缓存的部分被截断
+ * 日志器的格式涉及本地时间转换等非异步信号安全的调用, 崩溃时不使用, 统一格式为
+ * "!CRASH 秒.微秒 [等级] (文件:行号) 内容"
+ * @param msg 消息
+ * @return 格式化结果, 下一次调用前有效
+ */
+std::string_view FormatLine(const Msg& msg);
+
+/**
+ * 安装 SIGSEGV/SIGABRT/SIGBUS/SIGFPE/SIGILL 的处理函数, 并为调用线程设置备用信号栈
+ * @return 是否成功
+ */
+bool Install();
+
+/**
+ * 为当前线程设置备用信号栈, 栈溢出导致的 SIGSEGV 仍可在该线程中处理
+ * 备用信号栈仅对设置的线程生效, 库创建的后台线程启动时各自调用; 线程已有备用信号栈时不做修改
+ * @return 是否成功, 非 unix 平台始终失败
+ */
+bool InstallThreadStack();
+
+} // crash
+} // log
+} // tools
+
+#endif //TOOLS_LOG_CRASH_H_
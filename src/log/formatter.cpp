@@ -9,10 +9,16 @@
 #include "formatter.h"
 
 #include <ctime>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <charconv>
 #include <map>
+#include <mutex>
 #include <functional>
 #include <utility>
 
+#include "json.h"
 #include "logger.h"
 
 #define DEFAULT_DATETIME_PATTERN      "%Y-%m-%d %H:%M:%S"
@@ -23,23 +29,179 @@ namespace formatter {
 
 /**
  * 时间戳处理模块
+ * 日期时间部分按秒缓存(每线程每实例一份), 同一秒内仅追加小数部分
+ * 除 strftime 格式外额外支持: %L 毫秒, %f 微秒, %N 纳秒
  */
 class TimeStamp : public Formatter::Item {
+  /**
+   * 单个缓存最多支持的小数部分个数
+   */
+  static constexpr size_t k_max_fraction = 4;
+  /**
+   * 格式片段: strftime 格式 + 其后紧跟的小数位数(0 表示无)
+   */
+  struct Segment {
+    std::string format;
+    uint8_t digits;
+  };
+  /**
+   * 已渲染的当前秒内容, 小数部分以 0 占位, 输出时按偏移覆盖
+   */
+  struct Cache {
+    uint64_t owner = 0;
+    time_t sec = 0;
+    size_t len = 0;
+    char text[256];
+    size_t fraction_count = 0;
+    struct {
+      size_t offset;
+      uint8_t digits;
+    } fractions[k_max_fraction];
+  };
  public:
   explicit TimeStamp(const std::string& format)
-    : format_(std::move(format)) {
+    : format_(std::move(format)),
+      id_(NextId()),
+      slot_(Slots().Acquire()) {
     // TODO: verify format
+    Compile();
+  }
+  ~TimeStamp() {
+    Slots().Release(slot_);
   }
-  ~TimeStamp() = default;
-  std::string operator()(const struct Msg& msg) override {
-    char buffer[256]{0};
+  void operator()(const struct Msg& msg, std::string& out) override {
+    auto ns = msg.nanos();
+    auto sec = static_cast<time_t>(ns / 1000000000);
+    auto nsec = ns % 1000000000;
+    if (nsec < 0) {
+      nsec += 1000000000;
+      --sec;
+    }
+    auto& cache = Lookup(sec);
+    auto base = out.size();
+    out.append(cache.text, cache.len);
+    for (size_t i = 0; i < cache.fraction_count; i++) {
+      auto& fraction = cache.fractions[i];
+      auto value = nsec;
+      for (auto d = fraction.digits; d < 9; d++) value /= 10;
+      // 由低位向高位覆盖占位的 0
+      for (auto d = fraction.digits; d > 0; d--) {
+        out[base + fraction.offset + d - 1] = static_cast<char>('0' + value % 10);
+        value /= 10;
+      }
+    }
+  }
+ private:
+  static uint64_t NextId() {
+    static std::atomic<uint64_t> id{0};
+    return ++id;
+  }
+  /**
+   * 线程缓存槽位分配, 实例析构后槽位复用, 线程缓存数量不超过同时存在的实例数
+   */
+  class SlotPool {
+   public:
+    size_t Acquire() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (free_.empty()) return count_++;
+      auto slot = free_.back();
+      free_.pop_back();
+      return slot;
+    }
+    void Release(size_t slot) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_.push_back(slot);
+    }
+   private:
+    std::mutex mutex_;
+    std::vector<size_t> free_;
+    size_t count_ = 0;
+  };
+  static SlotPool& Slots() {
+    static SlotPool pool;
+    return pool;
+  }
+  /**
+   * 将格式按小数部分拆分为若干 strftime 片段
+   */
+  void Compile() {
+    std::string sub_str;
+    for (size_t i = 0; i < format_.size(); i++) {
+      if (format_[i] != '%' || i + 1 >= format_.size()) {
+        sub_str.append(1, format_[i]);
+        continue;
+      }
+      uint8_t digits = 0;
+      switch (format_[i + 1]) {
+        case 'L': digits = 3; break;
+        case 'f': digits = 6; break;
+        case 'N': digits = 9; break;
+        default: break;
+      }
+      if (digits && segments_.size() < k_max_fraction) {
+        segments_.push_back({std::move(sub_str), digits});
+        sub_str.clear();
+      } else {
+        // 其余转义(含 %%)原样交给 strftime
+        sub_str.append(format_, i, 2);
+      }
+      ++i;
+    }
+    if (!sub_str.empty()) segments_.push_back({std::move(sub_str), 0});
+  }
+  /**
+   * 取当前线程中该实例的缓存, 槽位被复用或秒数变化时重新渲染
+   * @param sec 秒级时间戳
+   * @return 缓存
+   */
+  Cache& Lookup(time_t sec) {
+    static thread_local std::vector<Cache> caches;
+    if (slot_ >= caches.size()) caches.resize(slot_ + 1);
+    auto& cache = caches[slot_];
+    if (cache.owner == id_ && cache.sec == sec && cache.len) return cache;
+    cache.owner = id_;
+    Render(cache, sec);
+    return cache;
+  }
+  /**
+   * 渲染指定秒的日期时间部分
+   * @param cache 目标缓存
+   * @param sec 秒级时间戳
+   */
+  void Render(Cache& cache, time_t sec) const {
     struct tm _tm{};
-    localtime_s(&_tm, &msg.time);
-    std::strftime(buffer, sizeof(buffer), format_.c_str(), &_tm);
-    return buffer;
+#if _WIN32
+    localtime_s(&_tm, &sec);
+#else
+    localtime_r(&sec, &_tm);
+#endif
+    cache.sec = sec;
+    cache.len = 0;
+    cache.fraction_count = 0;
+    for (auto& i : segments_) {
+      auto left = sizeof(cache.text) - cache.len;
+      if (!i.format.empty()) {
+        cache.len += std::strftime(cache.text + cache.len, left, i.format.c_str(), &_tm);
+        left = sizeof(cache.text) - cache.len;
+      }
+      if (i.digits && i.digits < left) {
+        cache.fractions[cache.fraction_count++] = {cache.len, i.digits};
+        std::memset(cache.text + cache.len, '0', i.digits);
+        cache.len += i.digits;
+      }
+    }
   }
  private:
   const std::string format_;
+  /**
+   * 全局唯一标识, 用于区分复用槽位的线程缓存的归属
+   */
+  const uint64_t id_;
+  /**
+   * 线程缓存中的下标
+   */
+  const size_t slot_;
+  std::vector<Segment> segments_;
 };
 
 /**
@@ -48,13 +210,9 @@ class TimeStamp : public Formatter::Item {
 class FileName : public Formatter::Item {
  public:
   ~FileName() = default;
-  std::string operator()(const struct Msg& msg) override {
-#ifdef _WIN32
-    auto str = std::strrchr(msg.file, '\\');
-#else
-    auto str = std::strrchr(msg.file, '/');
-#endif
-    return str ? str + 1 : msg.file;
+  void operator()(const struct Msg& msg, std::string& out) override {
+    // 文件名已在编译期取出
+    out.append(msg.site->base);
   }
 };
 
@@ -64,8 +222,8 @@ class FileName : public Formatter::Item {
 class FuncName : public Formatter::Item {
  public:
   ~FuncName() = default;
-  std::string operator()(const struct Msg& msg) override {
-    return msg.func;
+  void operator()(const struct Msg& msg, std::string& out) override {
+    out.append(msg.site->func);
   }
 };
 
@@ -75,8 +233,10 @@ class FuncName : public Formatter::Item {
 class Line : public Formatter::Item {
  public:
   ~Line() = default;
-  std::string operator()(const struct Msg& msg) override {
-    return std::to_string(msg.line);
+  void operator()(const struct Msg& msg, std::string& out) override {
+    char buffer[24];
+    auto res = std::to_chars(buffer, buffer + sizeof(buffer), msg.site->line);
+    out.append(buffer, res.ptr - buffer);
   }
 };
 
@@ -86,11 +246,12 @@ class Line : public Formatter::Item {
 class Level : public Formatter::Item {
  public:
   ~Level() = default;
-  std::string operator()(const struct Msg& msg) override {
+  void operator()(const struct Msg& msg, std::string& out) override {
     switch (msg.level) {
 #define XX(LVL) \
     case level::LVL: \
-      return #LVL;
+      out.append(#LVL, sizeof(#LVL) - 1); \
+      break;
 
       XX(DEBUG)
       XX(INFO)
@@ -99,7 +260,7 @@ class Level : public Formatter::Item {
       XX(FATAL)
 #undef XX
       default:
-        return "UNKNOWN";
+        out.append("UNKNOWN", 7);
     }
   }
 };
@@ -110,8 +271,19 @@ class Level : public Formatter::Item {
 class Content : public Formatter::Item {
  public:
   ~Content() = default;
-  std::string operator()(const struct Msg& msg) override {
-    return msg.content;
+  void operator()(const struct Msg& msg, std::string& out) override {
+    out.append(msg.content);
+  }
+};
+
+/**
+ * 结构化字段处理模块, 以 key=value 输出, 每个字段后跟一个空格
+ */
+class Fields : public Formatter::Item {
+ public:
+  ~Fields() = default;
+  void operator()(const struct Msg& msg, std::string& out) override {
+    json::AppendText(out, msg.fields);
   }
 };
 
@@ -123,8 +295,8 @@ class RawStr : public Formatter::Item {
   explicit RawStr(const std::string& buf)
     : buf_(std::move(buf)) {};
   ~RawStr() = default;
-  std::string operator()(const struct Msg& msg) override {
-    return buf_;
+  void operator()(const struct Msg&, std::string& out) override {
+    out.append(buf_);
   }
  private:
   const std::string buf_;
@@ -146,18 +318,23 @@ bool Formatter::Parse(const std::string &pattern) {
       XX(c, FuncName)         // c 函数名
       XX(l, Line)             // l 行号
       XX(m, Content)          // m 消息
+      XX(k, Fields)           // k 结构化字段
 #undef XX
   };
+  pattern_.clear();
   std::string sub_str;
-  for (int i = 0, j; i < pattern.size(); i++) {
+  // 将累计的原有字符合并为一项, 空字符串不生成处理模块
+  auto flush_raw = [&]() {
+    if (sub_str.empty()) return;
+    pattern_.emplace_back(Item::Ptr(new formatter::RawStr(sub_str)));
+    sub_str.clear();
+  };
+  for (size_t i = 0, j; i < pattern.size(); i++) {
     // 不为%
     if (pattern[i] != '%') {
       sub_str.append(1, pattern[i]);
       continue;
     }
-    // 为%
-    pattern_.emplace_back(Item::Ptr(new formatter::RawStr(sub_str)));
-    sub_str.clear();
 
     j = ++i;
     if (j >= pattern.size()) break;
@@ -169,7 +346,7 @@ bool Formatter::Parse(const std::string &pattern) {
       // 判断是否有自定义格式
       if (pattern[j] == '{') {
         // { }对应判断
-        int front_bracket_index = j, front_bracket_count = 0, last_bracket_index = 0;
+        size_t front_bracket_index = j, front_bracket_count = 0, last_bracket_index = 0;
         for (++j; j < pattern.size(); j++) {
           if (pattern[j] == '{')
             ++front_bracket_count;
@@ -183,25 +360,34 @@ bool Formatter::Parse(const std::string &pattern) {
         }
         // 若对应上则记为格式字符串
         if (last_bracket_index > front_bracket_index) {
-          date_str = pattern.substr(++front_bracket_index,
-                                    last_bracket_index - front_bracket_index);
+          date_str = pattern.substr(front_bracket_index + 1,
+                                    last_bracket_index - front_bracket_index - 1);
           i = last_bracket_index;
         }
       }
 //      std::cout << date_str << std::endl;
+      flush_raw();
       pattern_.emplace_back(Item::Ptr(new formatter::TimeStamp(date_str)));
     } else {
       auto res = k_formatters.find(pattern.substr(j, 1));
       // 找到对应处理函数则推入数组, 未找到则记为原始字符串继续循环
       if (res != k_formatters.end()) {
+        flush_raw();
         pattern_.push_back(res->second());
       } else {
         sub_str.append(1, pattern[j]);
       }
     }
   }
+  flush_raw();
   return true;
 }
 
+void Formatter::Format(const struct Msg& msg, std::string& out) const {
+  for (auto& i : pattern_) {
+    (*i)(msg, out);
+  }
+}
+
 } // log
 } // tools
\ No newline at end of file
@@ -34,21 +34,29 @@ class Formatter {
     /**
      * 以()运算符作为基本接口, 便于调用
      * @param msg 数据
-     * @return 字符串
+     * @param out 输出缓存, 结果直接追加至末尾
      */
-    virtual std::string operator()(const struct Msg& msg) = 0;
+    virtual void operator()(const struct Msg& msg, std::string& out) = 0;
   };
  public:
   Formatter();
   ~Formatter();
 
   /**
-   * 解析格式
+   * 解析格式, 相邻的原有字符会合并为一项, 空项会被忽略
    * @param pattern 带解析的格式字符串
    * @return 是否正确解析
    */
   bool Parse(const std::string& pattern);
 
+  /**
+   * 按已解析的格式将消息追加至缓存
+   * 缓存由调用者复用, 容量稳定后整个过程不再分配内存
+   * @param msg 消息
+   * @param out 输出缓存
+   */
+  void Format(const struct Msg& msg, std::string& out) const;
+
   inline const std::vector<Item::Ptr>& pattern() const {
     return pattern_;
   }
@@ -0,0 +1,208 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 21:03:15
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 21:03:15
+ * @Description:
+ */
+
+#include "index.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+
+#include <tick.h>
+
+namespace tools {
+namespace log {
+namespace idx {
+namespace {
+
+template <typename T>
+inline void Put(std::string& buf, const T& value) {
+  buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void PutStr(std::string& buf, std::string_view str) {
+  Put(buf, static_cast<uint32_t>(str.size()));
+  buf.append(str.data(), str.size());
+}
+
+/**
+ * 顺序读取内存中的索引内容
+ */
+class Cursor {
+ public:
+  explicit Cursor(const std::string& data)
+      : data_(data) {}
+  template <typename T>
+  bool Get(T& value) {
+    if (offset_ + sizeof(T) > data_.size()) return false;
+    memcpy(&value, data_.data() + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+  bool GetStr(std::string& str) {
+    uint32_t size;
+    if (!Get(size) || offset_ + size > data_.size()) return false;
+    str.assign(data_, offset_, size);
+    offset_ += size;
+    return true;
+  }
+ private:
+  const std::string& data_;
+  size_t offset_ = 0;
+};
+
+} // namespace
+
+Writer::Writer(std::string path, size_t block, std::string logger)
+    : path_(std::move(path)),
+      block_(block),
+      logger_(std::move(logger)) {
+  Open();
+}
+
+Writer::~Writer() {
+  Finish();
+  Close();
+}
+
+void Writer::Add(size_t size, const Span& span) {
+  if (!size) return;
+  size_ += size;
+  span_.Merge(span);
+  if (size_ >= block_) EndBlock();
+}
+
+void Writer::Commit() {
+  if (buffer_.empty()) return;
+  if (file_) {
+    fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    fflush(file_);
+  }
+  buffer_.clear();
+}
+
+void Writer::Finish() {
+  if (size_) EndBlock();
+  Commit();
+}
+
+void Writer::Rotate(const std::string& archive) {
+  Finish();
+  Close();
+  if (!archive.empty()) std::rename(path_.c_str(), Path(archive).c_str());
+  offset_ = 0;
+  Open();
+}
+
+void Writer::Open() {
+  file_ = std::fopen(path_.c_str(), "wb");
+  if (!file_) {
+    // TODO: Throw Exception
+    return;
+  }
+  buffer_.append(k_magic, sizeof(k_magic) - 1);
+  Put(buffer_, k_version);
+  Put(buffer_, static_cast<uint32_t>(block_));
+  // 每个索引文件对应一个日志器
+  Put(buffer_, NAME);
+  Put(buffer_, static_cast<uint16_t>(0));
+  PutStr(buffer_, logger_);
+  Commit();
+}
+
+void Writer::Close() {
+  if (!file_) return;
+  std::fclose(file_);
+  file_ = nullptr;
+}
+
+void Writer::EndBlock() {
+  // 时间在块结束时才换算, 每块仅两次
+  Put(buffer_, BLOCK);
+  Put(buffer_, offset_);
+  Put(buffer_, static_cast<uint32_t>(size_));
+  Put(buffer_, span_.levels ? tick::ToNanos(span_.min_time) : int64_t(0));
+  Put(buffer_, span_.levels ? tick::ToNanos(span_.max_time) : int64_t(0));
+  Put(buffer_, span_.levels);
+  Put(buffer_, static_cast<uint16_t>(0));
+  offset_ += size_;
+  size_ = 0;
+  span_ = {};
+}
+
+bool Reader::Open(const std::string& path) {
+  blocks_.clear();
+  loggers_.clear();
+  std::error_code ec;
+  size_ = std::filesystem::file_size(path, ec);
+  if (ec) return false;
+  std::ifstream ifs(Path(path), std::ios::binary);
+  if (!ifs.is_open()) return false;
+  std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  Cursor cursor(data);
+  char magic[sizeof(k_magic) - 1];
+  uint32_t version;
+  uint32_t block;
+  for (auto& i : magic) {
+    if (!cursor.Get(i)) return false;
+  }
+  if (memcmp(magic, k_magic, sizeof(magic)) != 0 || !cursor.Get(version) || version != k_version ||
+      !cursor.Get(block)) {
+    return false;
+  }
+  uint8_t type;
+  while (cursor.Get(type)) {
+    if (type == NAME) {
+      uint16_t id;
+      std::string name;
+      if (!cursor.Get(id) || !cursor.GetStr(name)) break;
+      if (loggers_.size() <= id) loggers_.resize(id + 1);
+      loggers_[id] = std::move(name);
+    } else if (type == BLOCK) {
+      Block i{};
+      if (!cursor.Get(i.offset) || !cursor.Get(i.size) || !cursor.Get(i.begin) || !cursor.Get(i.end) ||
+          !cursor.Get(i.levels) || !cursor.Get(i.logger)) {
+        break;
+      }
+      // 日志文件被截断时丢弃超出的块
+      if (i.offset + i.size > size_ || (!blocks_.empty() && i.offset != indexed())) break;
+      blocks_.push_back(i);
+    } else {
+      break;
+    }
+  }
+  return true;
+}
+
+std::vector<Range> Reader::Find(const Query& query) const {
+  std::vector<Range> ranges;
+  auto append = [&](uint64_t offset, uint64_t size) {
+    if (!size) return;
+    if (!ranges.empty() && ranges.back().offset + ranges.back().size == offset) {
+      ranges.back().size += size;
+    } else {
+      ranges.push_back({offset, size});
+    }
+  };
+  for (auto& i : blocks_) {
+    if (!(i.levels & query.levels) || i.begin > query.end || i.end < query.begin) continue;
+    if (!query.logger.empty() && logger(i.logger) != query.logger) continue;
+    append(i.offset, i.size);
+  }
+  append(indexed(), size_ - indexed());
+  return ranges;
+}
+
+const std::string& Reader::logger(uint16_t id) const {
+  static const std::string empty;
+  return id < loggers_.size() ? loggers_[id] : empty;
+}
+
+} // idx
+} // log
+} // tools
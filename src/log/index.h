@@ -0,0 +1,212 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 21:03:15
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 21:03:15
+ * @Description: 文本日志的稀疏旁路索引, 按时间范围/等级定位文件中的块, 由 log_query 使用
+ */
+
+#ifndef TOOLS_LOG_INDEX_H_
+#define TOOLS_LOG_INDEX_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "log.h"
+
+namespace tools {
+namespace log {
+namespace idx {
+
+// 索引文件结构, 文件名为日志文件名加 ".idx"
+// +------------------+------------------+------------------+
+// | magic (8 bytes)  | version (4 bytes)| block size (4)   |  文件头
+// +------------------+------------------+------------------+
+// | type (1 byte)    |          record body                |  记录 ...
+// +------------------+-------------------------------------+
+//
+// NAME  : | id (2) | name (str) |
+// BLOCK : | offset (8) | size (4) | begin ns (8) | end ns (8) | levels (1) | logger id (2) |
+// str   : | size (4) | bytes |
+// 块以行为边界, 写入约 block size 字节后结束; begin/end 为块内消息的最早/最晚时间
+// 最后一个块之后的内容(尚未写满一块或崩溃前未记录)不在索引中, 查询时总是包含
+
+constexpr char k_magic[] = "TLOGIDX1";
+constexpr uint32_t k_version = 1;
+
+/**
+ * 记录类型
+ */
+enum RECORD : uint8_t {
+  NAME = 1,     // 日志器名称, 块以 id 引用
+  BLOCK,        // 块描述
+};
+
+/**
+ * 一段内容的统计, 时间为 tick::Now() 的原始计数
+ */
+struct Span {
+  uint8_t levels = 0;               // 等级位图, 第 n 位对应 level::LEVEL n
+  uint64_t min_time = UINT64_MAX;
+  uint64_t max_time = 0;
+  inline void Merge(const Span& other) {
+    levels |= other.levels;
+    min_time = std::min(min_time, other.min_time);
+    max_time = std::max(max_time, other.max_time);
+  }
+};
+
+/**
+ * 不低于 level 的等级位图
+ */
+constexpr uint8_t AtLeast(level::LEVEL level) {
+  return static_cast<uint8_t>(0xFF << level);
+}
+
+/**
+ * 块描述, 时间为自 1970-01-01 起的纳秒数
+ */
+struct Block {
+  uint64_t offset;
+  uint32_t size;
+  int64_t begin;
+  int64_t end;
+  uint8_t levels;
+  uint16_t logger;
+};
+
+/**
+ * 索引写入, 由文件输出端在写出内容后调用, 需由调用方保证串行
+ * 每段内容仅合并统计, 块结束时才换算时间并编码, 编码结果在 Commit 时一次写出
+ */
+class Writer {
+ public:
+  /**
+   * @param path 索引文件路径
+   * @param block 块大小(字节)
+   * @param logger 日志器名称
+   */
+  Writer(std::string path, size_t block, std::string logger);
+  ~Writer();
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+  /**
+   * 记录已写出至日志文件的一段内容, 需以行为边界
+   * @param size 长度
+   * @param span 统计
+   */
+  void Add(size_t size, const Span& span);
+  /**
+   * 写出已结束的块
+   */
+  void Commit();
+  /**
+   * 结束当前块并写出, 日志文件关闭或轮转前调用
+   */
+  void Finish();
+  /**
+   * 日志文件轮转, 当前索引重命名为 archive 对应的索引并重新开始
+   * 归档文件将被压缩时索引中的偏移不再适用, 传入空路径丢弃当前索引
+   * @param archive 日志文件的归档路径, 为空时不保留
+   */
+  void Rotate(const std::string& archive);
+ private:
+  void Open();
+  void Close();
+  /**
+   * 结束当前块, 编码至 buffer_
+   */
+  void EndBlock();
+ private:
+  std::string path_;
+  size_t block_;
+  std::string logger_;
+  std::FILE* file_ = nullptr;
+  /**
+   * 当前块的起始位置, 大小及统计
+   */
+  uint64_t offset_ = 0;
+  size_t size_ = 0;
+  Span span_;
+  /**
+   * 已编码待写出的记录
+   */
+  std::string buffer_;
+};
+
+/**
+ * 查询条件, 时间为自 1970-01-01 起的纳秒数
+ */
+struct Query {
+  int64_t begin = INT64_MIN;
+  int64_t end = INT64_MAX;
+  uint8_t levels = 0xFF;    // 块中包含任一等级即匹配
+  std::string logger;       // 为空时不限制
+};
+
+/**
+ * 日志文件中的一段连续内容
+ */
+struct Range {
+  uint64_t offset;
+  uint64_t size;
+};
+
+/**
+ * 索引读取
+ */
+class Reader {
+ public:
+  /**
+   * 读取日志文件对应的索引, 末尾不完整的记录被忽略
+   * @param path 日志文件路径
+   * @return 日志文件或索引文件无效时返回 false
+   */
+  bool Open(const std::string& path);
+  /**
+   * 查找可能包含匹配内容的范围, 相邻的块合并为一段, 未索引的末尾内容总是包含
+   * 统计以块为单位, 范围内仍可能有不匹配的行
+   * @param query 查询条件
+   * @return 按偏移排序的范围
+   */
+  std::vector<Range> Find(const Query& query) const;
+  inline const std::vector<Block>& blocks() const {
+    return blocks_;
+  }
+  /**
+   * 日志器名称, id 不存在时返回空字符串
+   */
+  const std::string& logger(uint16_t id) const;
+  /**
+   * 日志文件大小
+   */
+  inline uint64_t size() const {
+    return size_;
+  }
+  /**
+   * 已索引的字节数, 其后的内容不在索引中
+   */
+  inline uint64_t indexed() const {
+    return blocks_.empty() ? 0 : blocks_.back().offset + blocks_.back().size;
+  }
+ private:
+  std::vector<Block> blocks_;
+  std::vector<std::string> loggers_;
+  uint64_t size_ = 0;
+};
+
+/**
+ * 索引文件路径
+ */
+inline std::string Path(const std::string& path) {
+  return path + ".idx";
+}
+
+} // idx
+} // log
+} // tools
+
+#endif //TOOLS_LOG_INDEX_H_
@@ -10,73 +10,696 @@
 
 #if _WIN32
 #include <io.h>
-#define F_EXISTED     0
+#include <fcntl.h>
+#include <sys/stat.h>
 #elif __unix__
+#include <fcntl.h>
 #include <unistd.h>
-#define F_EXISTED     F_OK
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
 #endif
 
-#include <iostream>
+#include <cerrno>
+#include <cstdio>
+#include <cctype>
+#include <ctime>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <tuple>
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
 #include <utility>
 
+#include <zlib.h>
+#include <nanomsg/nn.h>
+#include <nanomsg/pubsub.h>
+#include <nanomsg/pipeline.h>
+
+#include <async.h>
+
+#include "shm.h"
+#include "index.h"
+#include "binary.h"
+#include "logger.h"
+#include "metrics.h"
+
 namespace tools {
 namespace log {
 namespace output {
 
+namespace {
+
+/**
+ * 历史文件名中创建时间 "YYYYmmdd-HHMMSS" 的长度
+ */
+constexpr size_t k_stamp_len = 15;
+
+/**
+ * 打开文件
+ * @param path 文件路径
+ * @param truncate 是否清空原有内容
+ * @return 文件描述符, 失败时返回 -1
+ */
+int OpenFile(const std::string& path, bool truncate) {
+#if _WIN32
+  return _open(path.c_str(),
+               _O_WRONLY | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : _O_APPEND),
+               _S_IREAD | _S_IWRITE);
+#elif __unix__
+  return open(path.c_str(),
+              O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : O_APPEND),
+              0644);
+#endif
+}
+
+void CloseFile(int fd) {
+  if (fd < 0) return;
+#if _WIN32
+  _close(fd);
+#elif __unix__
+  close(fd);
+#endif
+}
+
+/**
+ * 写入全部数据, 处理部分写入的情况
+ * @param fd 文件描述符
+ * @param data 数据
+ * @param size 长度
+ */
+void WriteFd(int fd, const char* data, size_t size) {
+  while (size > 0) {
+#if _WIN32
+    auto n = _write(fd, data, static_cast<unsigned int>(size));
+#elif __unix__
+    auto n = write(fd, data, size);
+    if (n < 0 && errno == EINTR) continue;
+#endif
+    if (n <= 0) return;
+    data += n;
+    size -= n;
+  }
+}
+
+/**
+ * 输出端初始化失败时输出至标准错误, 此后该输出端的内容计入 dropped
+ * @param what 失败的操作
+ * @param target 操作对象, 如文件路径/地址
+ * @param err 错误码, 为 0 时表示对象无效或平台不支持
+ */
+void ReportError(const char* what, const std::string& target, int err) {
+  std::fprintf(stderr, "log: %s %s failed: %s\n", what, target.c_str(),
+               err ? std::strerror(err) : "invalid or unsupported");
+}
+
+/**
+ * 控制台缓存大小, 超过时提前写出
+ */
+constexpr size_t k_console_buffer = 64 * 1024;
+
+/**
+ * 各等级对应的 ANSI 颜色
+ */
+constexpr std::string_view k_colors[level::NUM_LEVEL] = {
+  "\033[36m",      // DEBUG 青色
+  "\033[32m",      // INFO  绿色
+  "\033[33m",      // WARN  黄色
+  "\033[31m",      // ERROR 红色
+  "\033[1;31m",    // FATAL 红色加粗
+};
+
+constexpr std::string_view k_color_reset = "\033[0m";
+
+} // namespace
+
+/**
+ * 控制台输出端, 经内部缓存直接写入标准输出/标准错误(fd 1/2), 不经过 iostream 及其全局锁
+ * 与 stdio 相同: 输出至终端时每批消息末尾写出; 输出至管道/文件时仅在缓存满, 遇到 ERROR 及以上等级
+ * (ON_LEVEL 策略为 flushLevel), 达到 flushBytes(BYTES 策略), 显式 Flush() 或每隔 flushInterval 毫秒时写出
+ * 批内切换输出目标时先写出已缓存内容以保持顺序
+ */
 class Console : public Outputter::Item {
  public:
-  ~Console() = default;
-  void operator<<(const std::string &str) override {
-    std::cout << str;
+  explicit Console(const Config& cfg)
+      : color_(cfg.consoleColor),
+        stderr_level_(cfg.consoleStderr ? level::ERROR : level::NUM_LEVEL),
+        interactive_(IsTerminal(1)),
+        flush_bytes_(cfg.flushPolicy == flush::BYTES ? std::min(cfg.flushBytes, k_console_buffer) : k_console_buffer),
+        flush_level_(cfg.flushPolicy == flush::ON_LEVEL ? std::min(cfg.flushLevel, level::ERROR) : level::ERROR),
+        flush_interval_(cfg.flushInterval) {
+    buffer_.reserve(k_console_buffer);
+    crash::Register(this, crash::SINK);
+    if (!interactive_) {
+      flusher_ = std::make_unique<async::Thread>("log.console", &Console::FlushLoop, this);
+    }
+  }
+  ~Console() override {
+    crash::Unregister(this, crash::SINK);
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (flusher_) flusher_->Join();
+    Flush();
+  }
+  void Write(level::LEVEL level, std::string_view str) override {
+    std::lock_guard<std::mutex> lk(mutex_);
+    Append(level, str);
+    if (NeedFlush(level)) FlushLocked();
+  }
+  void Write(const Outputter::Batch& batch, level::LEVEL min) override {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (!color_ && batch.max_level < stderr_level_) {
+      // 无需逐行处理时按段追加
+      batch.ForEachRun(min, [this](level::LEVEL, std::string_view str) {
+        Append(level::DEBUG, str);
+      });
+    } else {
+      size_t begin = 0;
+      for (auto& i : batch.lines) {
+        if (i.level >= min) Append(i.level, std::string_view(batch.data).substr(begin, i.end - begin));
+        begin = i.end;
+      }
+    }
+    if (NeedFlush(batch.max_level)) FlushLocked();
+  }
+  void Flush() override {
+    std::lock_guard<std::mutex> lk(mutex_);
+    FlushLocked();
+  }
+  void Drain() override {
+    // 崩溃时不加锁, 尽力写出缓存内容
+    if (!buffer_.empty()) WriteFd(fd_, buffer_.data(), buffer_.size());
+  }
+  void Emergency(level::LEVEL level, std::string_view str) override {
+    WriteFd(level >= stderr_level_ ? 2 : 1, str.data(), str.size());
+  }
+ private:
+  /**
+   * 追加至缓存, 需持有 mutex_
+   * @param level 消息等级, 决定输出目标及颜色
+   * @param str 内容
+   */
+  void Append(level::LEVEL level, std::string_view str) {
+    // 标准输出/标准错误
+    int fd = level >= stderr_level_ ? 2 : 1;
+    if (fd != fd_) {
+      FlushLocked();
+      fd_ = fd;
+    }
+    if (color_) {
+      // 颜色在换行前复位, 避免影响之后的输出
+      auto newline = !str.empty() && str.back() == '\n';
+      if (newline) str.remove_suffix(1);
+      buffer_.append(k_colors[level]);
+      buffer_.append(str);
+      buffer_.append(k_color_reset);
+      if (newline) buffer_.push_back('\n');
+    } else {
+      buffer_.append(str);
+    }
+    if (buffer_.size() >= k_console_buffer) FlushLocked();
+  }
+  /**
+   * 追加后是否需要立即写出, 需持有 mutex_
+   * @param level 本次追加内容中的最高等级
+   */
+  bool NeedFlush(level::LEVEL level) const {
+    return interactive_ || level >= flush_level_ || buffer_.size() >= flush_bytes_;
   }
+  void FlushLocked() {
+    if (buffer_.empty()) return;
+    WriteFd(fd_, buffer_.data(), buffer_.size());
+    buffer_.clear();
+  }
+  void FlushLoop() {
+    crash::InstallThreadStack();
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (!stop_) {
+      cv_.wait_for(lk, std::chrono::milliseconds(flush_interval_));
+      FlushLocked();
+    }
+  }
+  static bool IsTerminal(int fd) {
+#if _WIN32
+    return _isatty(fd);
+#elif __unix__
+    return isatty(fd);
+#endif
+  }
+ private:
+  bool color_;
+  level::LEVEL stderr_level_;
+  /**
+   * 标准输出为终端时按批写出, 否则按缓存写出
+   */
+  bool interactive_;
+  size_t flush_bytes_;
+  level::LEVEL flush_level_;
+  uint32_t flush_interval_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::unique_ptr<async::Thread> flusher_;
+  std::string buffer_;
+  /**
+   * 缓存内容的输出目标
+   */
+  int fd_ = 1;
 };
 
-class File : public Outputter::Item {
+/**
+ * 文件轮转辅助
+ * 后台线程以低优先级预先创建下一个文件, 并负责历史文件的压缩与清理, 写入方切换文件时仅需两次重命名
+ */
+class Rotator {
+ public:
+  explicit Rotator(const Config& cfg)
+      : path_(cfg.fileName),
+        next_path_(cfg.fileName + ".next"),
+        keep_(cfg.rotateKeep),
+        compress_(cfg.rotateCompress) {
+    thread_ = std::make_unique<async::Thread>("log.rotator", &Rotator::Loop, this);
+  }
+  ~Rotator() {
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_->Join();
+    if (next_fd_ >= 0) {
+      CloseFile(next_fd_);
+      std::remove(next_path_.c_str());
+    }
+  }
   /**
-   * 用于在不同OS下的即时同步
+   * 归档当前文件并切换至预先创建的文件, 未就绪时同步创建
+   * @param fd 当前文件描述符, 调用后关闭
+   * @param archive 归档文件路径
+   * @return 新文件描述符, 失败时返回 -1
    */
-  class Helper : public std::filebuf {
-   public:
-    inline int _fsync() {
+  int Rotate(int fd, const std::string& archive) {
+    int next;
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      next = next_fd_;
+      next_fd_ = -1;
+    }
+    CloseFile(fd);
+    std::rename(path_.c_str(), archive.c_str());
+    if (next >= 0 && std::rename(next_path_.c_str(), path_.c_str()) != 0) {
+      CloseFile(next);
+      next = -1;
+    }
+    if (next < 0) next = OpenFile(path_, true);
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      prepare_ = true;
+      archives_.push_back(archive);
+    }
+    cv_.notify_one();
+    return next;
+  }
+  /**
+   * 历史文件是否会被压缩, 压缩后索引中的偏移不再适用
+   */
+  inline bool compress() const {
+    return compress_;
+  }
+ private:
+  void Loop() {
+    crash::InstallThreadStack();
+    // 降低优先级, 压缩不与写入线程争抢 CPU
 #if _WIN32
-      return sync();
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
 #elif __unix__
-      return fsync(_M_file.fd());
+    async::Thread::Id id;
+    async::Thread::Helper::GetCurThreadId(id);
+    // Linux 下 nice 值按线程生效
+    setpriority(PRIO_PROCESS, static_cast<id_t>(id), 19);
 #endif
+    std::unique_lock<std::mutex> lk(mutex_);
+    for (;;) {
+      cv_.wait(lk, [&]{ return stop_ || prepare_ || !archives_.empty(); });
+      // 退出时放弃未完成的压缩, 历史文件保留原文
+      if (stop_) break;
+      // 创建期间 Rotate 可能再次请求, 已有就绪的文件时无需重建, 否则覆盖 next_fd_ 会泄漏描述符
+      if (prepare_) {
+        prepare_ = false;
+        if (next_fd_ < 0) {
+          lk.unlock();
+          auto fd = OpenFile(next_path_, true);
+          lk.lock();
+          if (next_fd_ >= 0) {
+            CloseFile(fd);
+          } else {
+            next_fd_ = fd;
+          }
+        }
+      }
+      if (!archives_.empty()) {
+        auto archive = std::move(archives_.front());
+        archives_.pop_front();
+        lk.unlock();
+        if (compress_) Compress(archive);
+        Prune();
+        lk.lock();
+      }
     }
-  };
+  }
+  /**
+   * 以 gzip 格式压缩历史文件, 成功后删除原文件
+   * @param path 历史文件路径
+   */
+  void Compress(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.is_open()) return;
+    auto gz_path = path + ".gz";
+    auto gz = gzopen(gz_path.c_str(), "wb");
+    if (!gz) return;
+    std::vector<char> buffer(64 * 1024);
+    bool ok = true;
+    while (ok && ifs) {
+      ifs.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      auto n = static_cast<int>(ifs.gcount());
+      ok = n == 0 || gzwrite(gz, buffer.data(), static_cast<unsigned>(n)) == n;
+    }
+    ok = gzclose(gz) == Z_OK && ok;
+    std::remove(ok ? path.c_str() : gz_path.c_str());
+  }
+  /**
+   * 按文件名(即创建时间)排序, 删除超出保留数量的最旧文件
+   */
+  void Prune() {
+    if (!keep_) return;
+    namespace fs = std::filesystem;
+    fs::path path(path_);
+    auto dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+    auto prefix = path.filename().string() + ".";
+    // 排序键为 (创建时间, 同一秒内的序号)
+    std::vector<std::tuple<std::string, unsigned long, fs::path> > files;
+    std::error_code ec;
+    for (fs::directory_iterator i(dir, ec), end; !ec && i != end; i.increment(ec)) {
+      auto name = i->path().filename().string();
+      if (name.size() < prefix.size() + k_stamp_len || name.compare(0, prefix.size(), prefix) != 0 ||
+          !std::isdigit(static_cast<unsigned char>(name[prefix.size()])) || IsIndex(name)) {
+        continue;
+      }
+      auto rest = name.c_str() + prefix.size() + k_stamp_len;
+      auto seq = rest[0] == '.' && std::isdigit(static_cast<unsigned char>(rest[1])) ? strtoul(rest + 1, nullptr, 10) : 0;
+      files.emplace_back(name.substr(prefix.size(), k_stamp_len), seq, i->path());
+    }
+    if (files.size() <= keep_) return;
+    std::sort(files.begin(), files.end());
+    for (size_t i = 0; i + keep_ < files.size(); i++) {
+      auto& file = std::get<2>(files[i]);
+      fs::remove(file, ec);
+      // 索引随历史文件一并删除, 压缩的历史文件没有索引
+      fs::remove(idx::Path(file.string()), ec);
+    }
+  }
+  static bool IsIndex(const std::string& name) {
+    auto suffix = idx::Path("");
+    return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+ private:
+  std::string path_;
+  std::string next_path_;
+  uint32_t keep_;
+  bool compress_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  /**
+   * 是否需要预先创建下一个文件
+   */
+  bool prepare_ = true;
+  int next_fd_ = -1;
+  /**
+   * 待压缩/清理的历史文件
+   */
+  std::deque<std::string> archives_;
+  std::unique_ptr<async::Thread> thread_;
+};
+
+class File : public Outputter::Item {
  public:
-  explicit File(std::string path)
-      : path_(std::move(path)),
-        ofs_(std::move(std::ofstream(path_))) {}
-  ~File() = default;
-  void operator<<(const std::string &str) override {
-    if (!Access() && !ReopenFile()) {
+  explicit File(const Config& cfg)
+      : path_(cfg.fileName),
+        policy_(cfg.flushPolicy),
+        flush_bytes_(cfg.flushBytes),
+        flush_interval_(cfg.flushInterval),
+        flush_level_(cfg.flushLevel),
+        sync_on_error_(cfg.syncOnError),
+        rotate_bytes_(cfg.rotateBytes),
+        rotate_policy_(cfg.rotatePolicy) {
+    fd_ = OpenFile(path_, true);
+    if (rotate_bytes_ || rotate_policy_ != rotate::NONE) {
+      rotator_ = std::make_unique<Rotator>(cfg);
+      opened_ = std::chrono::system_clock::now();
+      next_rotate_ = NextRotate(opened_);
+    }
+    if (cfg.indexBlock) {
+      index_ = std::make_unique<idx::Writer>(idx::Path(path_), cfg.indexBlock, cfg.name);
+    }
+    if (policy_ == flush::INTERVAL) {
+      flusher_ = std::make_unique<async::Thread>("log.flusher", &File::FlushLoop, this);
+    }
+    crash::Register(this, crash::SINK);
+  }
+  ~File() override {
+    crash::Unregister(this, crash::SINK);
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (flusher_) flusher_->Join();
+    Commit();
+    // 记录最后一个未写满的块
+    index_.reset();
+    CloseFile(fd_);
+  }
+  void Write(level::LEVEL level, std::string_view str) override {
+    idx::Span span;
+    if (index_) {
+      // 逐行写入时没有消息时间, 以写入时刻代替
+      auto now = tick::Now();
+      span = {static_cast<uint8_t>(1 << level), now, now};
+    }
+    Append(level, str, span);
+  }
+  void Write(const Outputter::Batch& batch, level::LEVEL min) override {
+    // 按段写出时以整批的统计作为各段的统计, 仅会多匹配而不会遗漏
+    idx::Span span{static_cast<uint8_t>(batch.levels & idx::AtLeast(min)), batch.min_time, batch.max_time};
+    batch.ForEachRun(min, [&](level::LEVEL level, std::string_view str) {
+      Append(level, str, span);
+    });
+  }
+  void Flush() override {
+    Commit();
+  }
+  void Drain() override {
+    // 崩溃时不加锁, 尽力写出尚未提交的内容; 正在提交中的内容无法确定是否已写出, 不再重复写入
+    if (fd_ >= 0 && !pending_.empty()) WriteFd(fd_, pending_.data(), pending_.size());
+  }
+  void Emergency(level::LEVEL, std::string_view str) override {
+    if (fd_ >= 0) WriteFd(fd_, str.data(), str.size());
+  }
+  void Sync() override {
+    if (fd_ >= 0) FSync();
+  }
+ private:
+  /**
+   * 追加待写入内容, 需要立即提交时不再拷贝至缓存, 与缓存中已有内容一并写出
+   * @param level 内容中的最高等级
+   * @param str 内容
+   * @param span 内容的统计, 用于索引
+   */
+  void Append(level::LEVEL level, std::string_view str, const idx::Span& span) {
+    bool commit;
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      commit = NeedCommit(level, pending_.size() + str.size());
+      if (!commit) {
+        pending_.append(str);
+        if (index_) pending_spans_.push_back({str.size(), span});
+      }
+    }
+    if (commit) Commit(str, span);
+  }
+  /**
+   * 按照落盘策略判断是否需要立即提交
+   * @param level 当前消息等级
+   * @param size 加入当前消息后待写入的字节数
+   * @return 是否需要提交
+   */
+  bool NeedCommit(level::LEVEL level, size_t size) const {
+    if (sync_on_error_ && level >= level::ERROR) return true;
+    switch (policy_) {
+      case flush::BYTES:
+        return size >= flush_bytes_;
+      case flush::INTERVAL:
+        return false;
+      case flush::ON_LEVEL:
+        return level >= flush_level_ || size >= flush_bytes_;
+      default:
+        return true;
+    }
+  }
+  /**
+   * 组提交: 将待写入的多行一次性写入并统一 fsync
+   * 提交期间仅持有 io_mutex_, 其他线程仍可继续追加, 追加的内容由下一次提交带走
+   * 索引在内容写出后按写出顺序记录, 已结束的块随提交一并写出, 不在追加路径上进行
+   * @param tail 追加在缓存内容之后写出的内容
+   * @param tail_span tail 的统计
+   */
+  void Commit(std::string_view tail = {}, const idx::Span& tail_span = {}) {
+    std::lock_guard<std::mutex> io_lk(io_mutex_);
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      if (pending_.empty() && tail.empty()) return;
+      pending_.swap(committing_);
+      pending_spans_.swap(committing_spans_);
+    }
+    auto size = committing_.size() + tail.size();
+    if (rotator_ && NeedRotate(size)) Rotate();
+    if (fd_ < 0) {
       // TODO: Throw Exception
+      committing_.clear();
+      committing_spans_.clear();
       return;
     }
-    ofs_ << str;
-    FSync();
+    WriteAll(committing_, tail);
+    {
+      Metrics::Timer timer(metrics_ ? &metrics_->Local().sync : nullptr);
+      FSync();
+    }
+    if (index_) {
+      for (auto& i : committing_spans_) {
+        index_->Add(i.first, i.second);
+      }
+      index_->Add(tail.size(), tail_span);
+      index_->Commit();
+    }
+    written_ += size;
+    committing_.clear();
+    committing_spans_.clear();
   }
- private:
   /**
-   * 重新打开文件
-   * @return 是否成功
+   * 写入 size 字节前判断是否需要轮转, 需持有 io_mutex_
+   * 单次提交的内容不会被拆分至两个文件
    */
-  bool ReopenFile() {
-    ofs_ = std::move(std::ofstream(path_, std::ios::binary | std::ios::app | std::ios::out));
-    return ofs_.is_open();
+  bool NeedRotate(size_t size) const {
+    if (rotate_bytes_ && written_ > 0 && written_ + size > rotate_bytes_) return true;
+    return rotate_policy_ != rotate::NONE && std::chrono::system_clock::now() >= next_rotate_;
   }
   /**
-   * 测试文件路径是否存在
-   * @return 是否存在
+   * 将当前文件以创建时间命名归档并切换至新文件, 需持有 io_mutex_
    */
-  bool Access() {
+  void Rotate() {
+    char stamp[32];
+    auto sec = std::chrono::system_clock::to_time_t(opened_);
+    struct tm _tm{};
 #if _WIN32
-    return _access_s(path_.c_str(), F_EXISTED) == 0;
-#elif __unix__
-    return access(path.c_str(), F_EXISTED) == 0;
+    localtime_s(&_tm, &sec);
+#else
+    localtime_r(&sec, &_tm);
+#endif
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &_tm);
+    auto archive = path_ + "." + stamp;
+    // 同一秒内多次轮转时追加序号
+    if (last_stamp_ == stamp) {
+      archive += "." + std::to_string(++seq_);
+    } else {
+      last_stamp_ = stamp;
+      seq_ = 0;
+    }
+    fd_ = rotator_->Rotate(fd_, archive);
+    if (index_) index_->Rotate(rotator_->compress() ? std::string() : archive);
+    written_ = 0;
+    opened_ = std::chrono::system_clock::now();
+    next_rotate_ = NextRotate(opened_);
+  }
+  /**
+   * 计算下一次按时间轮转的时刻
+   * @param now 当前时间
+   * @return 下一个本地整点/零点, 不按时间轮转时为最大值
+   */
+  std::chrono::system_clock::time_point NextRotate(std::chrono::system_clock::time_point now) const {
+    if (rotate_policy_ == rotate::NONE) return std::chrono::system_clock::time_point::max();
+    auto sec = std::chrono::system_clock::to_time_t(now);
+    struct tm _tm{};
+#if _WIN32
+    localtime_s(&_tm, &sec);
+#else
+    localtime_r(&sec, &_tm);
+#endif
+    _tm.tm_min = 0;
+    _tm.tm_sec = 0;
+    if (rotate_policy_ == rotate::HOURLY) {
+      _tm.tm_hour += 1;
+    } else {
+      _tm.tm_hour = 0;
+      _tm.tm_mday += 1;
+    }
+    _tm.tm_isdst = -1;
+    return std::chrono::system_clock::from_time_t(mktime(&_tm));
+  }
+  /**
+   * INTERVAL 策略下的定时落盘线程
+   */
+  void FlushLoop() {
+    crash::InstallThreadStack();
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (!stop_) {
+      cv_.wait_for(lk, std::chrono::milliseconds(flush_interval_));
+      lk.unlock();
+      Commit();
+      lk.lock();
+    }
+  }
+  /**
+   * 写入全部数据, 处理部分写入的情况
+   * @param data 数据
+   * @param size 长度
+   */
+  void WriteAll(const char* data, size_t size) {
+    WriteFd(fd_, data, size);
+  }
+  /**
+   * 依次写入两段数据, unix 下合并为一次 writev
+   */
+  void WriteAll(std::string_view head, std::string_view tail) {
+#if __unix__
+    struct iovec iov[2] = {
+      {const_cast<char*>(head.data()), head.size()},
+      {const_cast<char*>(tail.data()), tail.size()},
+    };
+    auto n = writev(fd_, iov, 2);
+    if (n < 0) {
+      if (errno != EINTR) return;
+      n = 0;
+    }
+    // 部分写入时逐段写出剩余内容
+    auto written = static_cast<size_t>(n);
+    if (written < head.size()) {
+      WriteAll(head.data() + written, head.size() - written);
+      written = head.size();
+    }
+    written -= head.size();
+    WriteAll(tail.data() + written, tail.size() - written);
+#else
+    WriteAll(head.data(), head.size());
+    WriteAll(tail.data(), tail.size());
 #endif
   }
   /**
@@ -84,27 +707,541 @@ class File : public Outputter::Item {
    * @return
    */
   int FSync() {
-    return reinterpret_cast<Helper *>(ofs_.rdbuf())->_fsync();
+#if _WIN32
+    return _commit(fd_);
+#elif __unix__
+    return fsync(fd_);
+#endif
+  }
+ private:
+  std::string path_;
+  int fd_ = -1;
+  flush::POLICY policy_;
+  size_t flush_bytes_;
+  uint32_t flush_interval_;
+  level::LEVEL flush_level_;
+  bool sync_on_error_;
+  size_t rotate_bytes_;
+  rotate::POLICY rotate_policy_;
+  /**
+   * 当前文件已写入字节数, 创建时间及下一次按时间轮转的时刻, 仅在持有 io_mutex_ 时访问
+   */
+  size_t written_ = 0;
+  std::chrono::system_clock::time_point opened_;
+  std::chrono::system_clock::time_point next_rotate_;
+  std::string last_stamp_;
+  uint32_t seq_ = 0;
+  /**
+   * mutex_ 保护待写入缓存, io_mutex_ 保证提交顺序及文件描述符访问
+   */
+  std::mutex mutex_;
+  std::mutex io_mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  /**
+   * 待写入缓存与正在提交的缓存, 交换使用以复用内存
+   */
+  std::string pending_;
+  std::string committing_;
+  /**
+   * 待写入/正在提交的各段内容的长度及统计, 仅在开启索引时记录
+   */
+  std::vector<std::pair<size_t, idx::Span> > pending_spans_;
+  std::vector<std::pair<size_t, idx::Span> > committing_spans_;
+  std::unique_ptr<async::Thread> flusher_;
+  std::unique_ptr<Rotator> rotator_;
+  std::unique_ptr<idx::Writer> index_;
+};
+
+#if __unix__
+/**
+ * 内存映射文件输出端
+ * 文件按 chunk 预先扩展并映射, 写入仅为 memcpy; 后台线程在当前块过半时映射下一块并解除已写满块的映射
+ * 稳定状态下写入不涉及系统调用, 关闭时将文件截断至实际大小
+ */
+class MMapFile : public Outputter::Item {
+ public:
+  explicit MMapFile(const Config& cfg)
+      : path_(cfg.fileName),
+        sync_on_error_(cfg.syncOnError) {
+    // 映射偏移需按页对齐
+    auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    chunk_size_ = (std::max(cfg.mmapChunk, page) + page - 1) / page * page;
+    fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ >= 0) cur_ = Map(0);
+    mapper_ = std::make_unique<async::Thread>("log.mapper", &MMapFile::MapLoop, this);
+    crash::Register(this, crash::SINK);
+  }
+  ~MMapFile() override {
+    crash::Unregister(this, crash::SINK);
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    mapper_->Join();
+    Unmap(cur_);
+    Unmap(next_);
+    for (auto& i : retired_) {
+      Unmap(i);
+    }
+    if (fd_ < 0) return;
+    // 去除预分配但未写入的部分, 截断位置为已写入的字节数, 映射失败后不会丢失已写入的内容
+    // 截断失败时文件末尾残留预分配的 0, 已写入的内容不受影响
+    auto res = ftruncate(fd_, static_cast<off_t>(written_));
+    (void)res;
+    close(fd_);
+  }
+  void Write(level::LEVEL level, std::string_view str) override {
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      auto data = str.data();
+      auto size = str.size();
+      while (size > 0 && cur_.base) {
+        auto n = std::min(size, chunk_size_ - pos_);
+        memcpy(cur_.base + pos_, data, n);
+        pos_ += n;
+        written_ += n;
+        data += n;
+        size -= n;
+        if (pos_ == chunk_size_) Advance();
+      }
+      // 映射失败后改为 pwrite 追加至已写入内容之后, 写入失败时计入 dropped
+      if (size > 0 && fd_ >= 0) {
+        auto n = PWrite(data, size, written_);
+        written_ += n;
+        data += n;
+        size -= n;
+      }
+      if (size > 0 && metrics_) {
+        metrics_->Local().dropped.fetch_add(std::max<size_t>(1, std::count(data, data + size, '\n')),
+                                            std::memory_order_relaxed);
+      }
+      // 当前块过半时通知后台线程预先映射下一块, 每块仅通知一次
+      if (cur_.base && !requested_ && pos_ >= chunk_size_ / 2) {
+        requested_ = true;
+        cv_.notify_one();
+      }
+    }
+    if (sync_on_error_ && level >= level::ERROR) Flush();
+  }
+  void Write(const Outputter::Batch& batch, level::LEVEL min) override {
+    batch.ForEachRun(min, [this](level::LEVEL level, std::string_view str) {
+      Write(level, str);
+    });
+  }
+  void Flush() override {
+    // Linux 下 fsync 同样会写回共享映射中的脏页
+    if (fd_ < 0) return;
+    Metrics::Timer timer(metrics_ ? &metrics_->Local().sync : nullptr);
+    fsync(fd_);
+  }
+  void Emergency(level::LEVEL, std::string_view str) override {
+    // 崩溃时不加锁, 当前块剩余空间不足或映射失败时以 pwrite 追加至已写入内容之后
+    if (fd_ < 0) return;
+    if (cur_.base && pos_ + str.size() <= chunk_size_) {
+      memcpy(cur_.base + pos_, str.data(), str.size());
+      pos_ += str.size();
+      written_ += str.size();
+    } else {
+      written_ += PWrite(str.data(), str.size(), written_);
+    }
+  }
+  void Sync() override {
+    // 进程即将退出, 析构不会执行, 在此去除预分配但未写入的部分; 与析构相同, 截断至已写入的字节数
+    if (fd_ < 0) return;
+    auto res = ftruncate(fd_, static_cast<off_t>(written_));
+    (void)res;
+    fsync(fd_);
+  }
+ private:
+  /**
+   * 文件中的一个映射块
+   */
+  struct Chunk {
+    char* base = nullptr;
+    size_t offset = 0;
+  };
+  /**
+   * 扩展文件并映射指定偏移处的块, 可能与后台线程并发调用
+   * @param offset 块在文件中的偏移
+   * @return 映射块, 失败时 base 为空
+   */
+  Chunk Map(size_t offset) {
+    std::lock_guard<std::mutex> lk(map_mutex_);
+    // 仅向后扩展, 避免过期的请求截断正在写入的块
+    if (offset + chunk_size_ > file_size_) {
+      if (ftruncate(fd_, static_cast<off_t>(offset + chunk_size_)) != 0) return {};
+      file_size_ = offset + chunk_size_;
+    }
+    auto base = mmap(nullptr, chunk_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, static_cast<off_t>(offset));
+    if (base == MAP_FAILED) return {};
+    return {static_cast<char*>(base), offset};
+  }
+  void Unmap(Chunk& chunk) {
+    if (!chunk.base) return;
+    munmap(chunk.base, chunk_size_);
+    chunk.base = nullptr;
+  }
+  /**
+   * 在 offset 处写入, 处理部分写入的情况, 仅调用异步信号安全的函数
+   * @return 实际写入的字节数
+   */
+  size_t PWrite(const char* data, size_t size, size_t offset) {
+    size_t written = 0;
+    while (written < size) {
+      auto n = pwrite(fd_, data + written, size - written, static_cast<off_t>(offset + written));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      written += static_cast<size_t>(n);
+    }
+    return written;
+  }
+  /**
+   * 切换至下一块, 需持有 mutex_
+   * 后台线程未及时映射时同步映射, 仍失败时此后改为 pwrite 写入
+   */
+  void Advance() {
+    auto offset = cur_.offset + chunk_size_;
+    retired_.push_back(cur_);
+    if (next_.base && next_.offset == offset) {
+      cur_ = next_;
+    } else {
+      Unmap(next_);
+      cur_ = Map(offset);
+    }
+    next_ = {};
+    pos_ = 0;
+    requested_ = false;
+    attempted_ = false;
+    cv_.notify_one();
+  }
+  /**
+   * 后台映射线程, 映射与解除映射均在锁外完成
+   */
+  void MapLoop() {
+    crash::InstallThreadStack();
+    std::unique_lock<std::mutex> lk(mutex_);
+    for (;;) {
+      cv_.wait(lk, [&]{ return stop_ || (requested_ && !attempted_) || !retired_.empty(); });
+      if (stop_) break;
+      auto retired = std::move(retired_);
+      retired_.clear();
+      // 每块仅尝试映射一次, 失败时由写入方切换时同步映射
+      auto map = requested_ && !attempted_ && cur_.base;
+      attempted_ = attempted_ || requested_;
+      auto offset = cur_.offset + chunk_size_;
+      lk.unlock();
+      for (auto& i : retired) {
+        Unmap(i);
+      }
+      Chunk chunk;
+      if (map) chunk = Map(offset);
+      lk.lock();
+      // 映射期间写入方可能已自行切换, 此时丢弃该块
+      if (!next_.base && cur_.offset + chunk_size_ == chunk.offset) {
+        next_ = chunk;
+      } else {
+        Unmap(chunk);
+      }
+    }
   }
  private:
   std::string path_;
-  std::ofstream ofs_;
+  int fd_ = -1;
+  bool sync_on_error_;
+  size_t chunk_size_;
+  /**
+   * mutex_ 保护映射块及写入位置, map_mutex_ 保证文件仅向后扩展
+   */
+  std::mutex mutex_;
+  std::mutex map_mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  Chunk cur_;
+  size_t pos_ = 0;
+  /**
+   * 已写入文件的字节数, 关闭时截断至此
+   */
+  size_t written_ = 0;
+  /**
+   * 预先映射的下一块
+   */
+  Chunk next_;
+  bool requested_ = false;
+  bool attempted_ = false;
+  /**
+   * 已写满待解除映射的块
+   */
+  std::vector<Chunk> retired_;
+  size_t file_size_ = 0;
+  std::unique_ptr<async::Thread> mapper_;
+};
+#endif // __unix__
+
+/**
+ * 创建文件输出端, 内存映射仅在 unix 下可用, 其他平台回退为普通文件
+ */
+Outputter::Item::Ptr MakeFile(const Config& cfg) {
+#if __unix__
+  if (cfg.mmap) {
+    return std::make_shared<MMapFile>(cfg);
+  }
+#endif
+  return std::make_shared<File>(cfg);
+}
+
+/**
+ * nanomsg 输出端, 将多行合并为一条消息发送至收集进程, 不占用本进程的磁盘 IO
+ * 每条消息首字节为其中的最高等级, 其后为连续的多行, 收集进程据此沿用落盘策略
+ * 合并方式沿用文件的落盘策略; 以非阻塞方式发送, 对端不可达, 发送缓冲区满或套接字创建失败时丢弃并计入 dropped
+ */
+class Ship : public Outputter::Item {
+ public:
+  Ship(const Config& cfg, const SinkConfig& sink)
+      : policy_(cfg.flushPolicy),
+        flush_bytes_(cfg.flushBytes),
+        flush_interval_(cfg.flushInterval),
+        flush_level_(cfg.flushLevel),
+        sync_on_error_(cfg.syncOnError) {
+    sock_ = nn_socket(AF_SP, sink.publish ? NN_PUB : NN_PUSH);
+    if (sock_ < 0) {
+      ReportError("nn_socket", sink.address, nn_errno());
+      return;
+    }
+    // 退出时最多等待 1 秒发送剩余消息
+    int linger = 1000;
+    nn_setsockopt(sock_, NN_SOL_SOCKET, NN_LINGER, &linger, sizeof(linger));
+    if (nn_connect(sock_, sink.address.c_str()) < 0) {
+      ReportError("nn_connect", sink.address, nn_errno());
+      nn_close(sock_);
+      sock_ = -1;
+      return;
+    }
+    Reset();
+    if (policy_ == flush::INTERVAL) {
+      flusher_ = std::make_unique<async::Thread>("log.shipper", &Ship::FlushLoop, this);
+    }
+  }
+  ~Ship() override {
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (flusher_) flusher_->Join();
+    Flush();
+    if (sock_ >= 0) nn_close(sock_);
+  }
+  void Write(level::LEVEL level, std::string_view str) override {
+    std::lock_guard<std::mutex> lk(mutex_);
+    AppendLocked(level, str);
+    if (NeedSend(level)) SendLocked();
+  }
+  void Write(const Outputter::Batch& batch, level::LEVEL min) override {
+    std::lock_guard<std::mutex> lk(mutex_);
+    batch.ForEachRun(min, [this](level::LEVEL level, std::string_view str) {
+      AppendLocked(level, str);
+    });
+    if (NeedSend(static_cast<level::LEVEL>(pending_[0]))) SendLocked();
+  }
+  void Flush() override {
+    std::lock_guard<std::mutex> lk(mutex_);
+    SendLocked();
+  }
+ private:
+  inline void Reset() {
+    pending_.assign(1, static_cast<char>(level::DEBUG));
+  }
+  void AppendLocked(level::LEVEL level, std::string_view str) {
+    if (sock_ < 0) {
+      if (metrics_) {
+        metrics_->Local().dropped.fetch_add(std::count(str.begin(), str.end(), '\n'), std::memory_order_relaxed);
+      }
+      return;
+    }
+    pending_[0] = static_cast<char>(std::max(static_cast<level::LEVEL>(pending_[0]), level));
+    pending_.append(str);
+  }
+  /**
+   * 按照落盘策略判断是否需要立即发送, 需持有 mutex_
+   * @param level 待发送内容中的最高等级
+   */
+  bool NeedSend(level::LEVEL level) const {
+    if (sync_on_error_ && level >= level::ERROR) return true;
+    switch (policy_) {
+      case flush::BYTES:
+        return pending_.size() - 1 >= flush_bytes_;
+      case flush::INTERVAL:
+        return false;
+      case flush::ON_LEVEL:
+        return level >= flush_level_ || pending_.size() - 1 >= flush_bytes_;
+      default:
+        return true;
+    }
+  }
+  /**
+   * 发送待发送内容, 需持有 mutex_
+   */
+  void SendLocked() {
+    if (sock_ < 0 || pending_.size() <= 1) return;
+    if (nn_send(sock_, pending_.data(), pending_.size(), NN_DONTWAIT) < 0 && metrics_) {
+      metrics_->Local().dropped.fetch_add(std::count(pending_.begin() + 1, pending_.end(), '\n'),
+                                          std::memory_order_relaxed);
+    }
+    Reset();
+  }
+  void FlushLoop() {
+    crash::InstallThreadStack();
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (!stop_) {
+      cv_.wait_for(lk, std::chrono::milliseconds(flush_interval_));
+      SendLocked();
+    }
+  }
+ private:
+  flush::POLICY policy_;
+  size_t flush_bytes_;
+  uint32_t flush_interval_;
+  level::LEVEL flush_level_;
+  bool sync_on_error_;
+  int sock_ = -1;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  /**
+   * 待发送内容, 首字节为其中的最高等级
+   */
+  std::string pending_;
+  std::unique_ptr<async::Thread> flusher_;
+};
+
+/**
+ * 共享内存输出端, 每段连续行仅拷贝一次至共享内存环, 无系统调用
+ * 内容在共享内存中, 进程崩溃后仍可由读取进程取出, 无需排空; 环满或段打开失败时丢弃并计入 dropped
+ */
+class Shm : public Outputter::Item {
+ public:
+  explicit Shm(const SinkConfig& sink) {
+    errno = 0;
+    if (!ring_.Open(sink.address, sink.shmSize)) ReportError("shm open", sink.address, errno);
+  }
+  void Write(level::LEVEL level, std::string_view str) override {
+    Put(level, str);
+  }
+  void Write(const Outputter::Batch& batch, level::LEVEL min) override {
+    batch.ForEachRun(min, [this](level::LEVEL level, std::string_view str) {
+      Put(level, str);
+    });
+  }
+  void Emergency(level::LEVEL level, std::string_view str) override {
+    ring_.Write(level, str);
+  }
+ private:
+  void Put(level::LEVEL level, std::string_view str) {
+    if (!ring_.Write(level, str) && metrics_) {
+      metrics_->Local().dropped.fetch_add(std::count(str.begin(), str.end(), '\n'), std::memory_order_relaxed);
+    }
+  }
+  shm::Ring ring_;
+};
+
+/**
+ * 二进制文件输出端, 复用文件输出端的组提交及落盘策略
+ */
+class BinFile : public Outputter::Binary {
+ public:
+  BinFile(const Config& cfg, Metrics* metrics)
+      : file_(MakeFile(NoRotate(cfg))) {
+    std::string header;
+    bin::EncodeHeader(cfg.pattern, header);
+    file_->Write(level::INFO, header);
+    file_->set_metrics(metrics);
+  }
+  ~BinFile() = default;
+  void Write(const Msg& msg) override {
+    // 调用点描述需先于引用它的记录写入, 编码与写入在同一锁内完成
+    std::lock_guard<std::mutex> lk(mutex_);
+    record_.clear();
+    encoder_(msg, record_);
+    file_->Write(msg.level, record_);
+  }
+  void Flush() override {
+    file_->Flush();
+  }
+ private:
+  /**
+   * 文件头及调用点描述仅写入一次, 二进制文件不支持轮转及索引
+   */
+  static Config NoRotate(Config cfg) {
+    cfg.rotateBytes = 0;
+    cfg.rotatePolicy = rotate::NONE;
+    cfg.indexBlock = 0;
+    return cfg;
+  }
+  std::mutex mutex_;
+  Outputter::Item::Ptr file_;
+  bin::Encoder encoder_;
+  std::string record_;
 };
 
 } // output
 
-Outputter::Outputter(const Config& cfg) {
+Outputter::Outputter(const Config& cfg, Metrics* metrics) {
   if (cfg.toConsole) {
-    console_ = std::move(Item::Ptr(new output::Console()));
+    AddSink(Item::Ptr(new output::Console(cfg)), level::DEBUG, cfg.pattern);
   }
-  if (cfg.toFile && cfg.fileName.empty()) {
-    // TODO: Throw Exception
-  } else {
-    file_ = std::move(Item::Ptr(new output::File(cfg.fileName)));
+  if (cfg.toFile) {
+    if (cfg.fileName.empty()) {
+      // TODO: Throw Exception
+    } else if (cfg.binary) {
+      binary_ = std::move(Binary::Ptr(new output::BinFile(cfg, metrics)));
+    } else {
+      AddSink(output::MakeFile(cfg), level::DEBUG, cfg.pattern);
+    }
+  }
+  for (auto& i : cfg.sinks) {
+    auto& pattern = i.pattern.empty() ? cfg.pattern : i.pattern;
+    if (i.type == sink::CONSOLE) {
+      AddSink(Item::Ptr(new output::Console(cfg)), i.minLevel, pattern);
+    } else if (i.type == sink::NET) {
+      AddSink(Item::Ptr(new output::Ship(cfg, i)), i.minLevel, pattern);
+    } else if (i.type == sink::SHM) {
+      AddSink(Item::Ptr(new output::Shm(i)), i.minLevel, pattern);
+    } else if (i.fileName.empty()) {
+      // TODO: Throw Exception
+    } else {
+      // 与日志器的文件共用落盘及轮转策略
+      auto file_cfg = cfg;
+      file_cfg.fileName = i.fileName;
+      AddSink(output::MakeFile(file_cfg), i.minLevel, pattern);
+    }
+  }
+  for (auto& i : sinks_) {
+    i.item->set_metrics(metrics);
+  }
+  if (!cfg.jsonFile.empty()) {
+    // 与文本文件共用落盘及轮转策略
+    auto json_cfg = cfg;
+    json_cfg.fileName = cfg.jsonFile;
+    json_ = output::MakeFile(json_cfg);
+    json_->set_metrics(metrics);
   }
 }
 
 Outputter::~Outputter() = default;
 
+void Outputter::AddSink(Item::Ptr item, level::LEVEL level, const std::string& pattern) {
+  auto res = std::find_if(formats_.begin(), formats_.end(), [&](const Format& i) {
+    return i.pattern == pattern;
+  });
+  if (res == formats_.end()) {
+    res = formats_.insert(formats_.end(), {pattern, level});
+  } else {
+    res->level = std::min(res->level, level);
+  }
+  sinks_.push_back({std::move(item), level, static_cast<size_t>(res - formats_.begin())});
+}
+
 } // log
 } // tools
\ No newline at end of file
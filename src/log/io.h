@@ -11,32 +11,189 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <string_view>
 
 #include <log.h>
 
+#include "crash.h"
+
 namespace tools {
 namespace log {
 
+struct Msg;
+class Metrics;
+
 class Outputter {
  public:
-  class Item {
+  /**
+   * 一批已格式化的消息, 各行在 data 中连续存放, 输出端可一次性写出
+   */
+  struct Batch {
+    struct Line {
+      level::LEVEL level;   // 消息等级
+      size_t end;           // 该行在 data 中的结束位置
+    };
+    std::string data;
+    std::vector<Line> lines;
+    level::LEVEL max_level = level::DEBUG;    // 批内最高等级, 用于判断是否需要立即落盘
+    level::LEVEL min_level = level::NUM_LEVEL;  // 批内最低等级, 用于判断能否整批写出
+    uint8_t levels = 0;                 // 批内等级位图
+    uint64_t min_time = UINT64_MAX;     // 批内最早/最晚的时间戳(原始计数), 用于文件索引
+    uint64_t max_time = 0;
+    inline void Clear() {
+      data.clear();
+      lines.clear();
+      max_level = level::DEBUG;
+      min_level = level::NUM_LEVEL;
+      levels = 0;
+      min_time = UINT64_MAX;
+      max_time = 0;
+    }
+    /**
+     * 标记 data 末尾为一行的结束
+     * @param level 该行等级
+     * @param time 该行时间戳(原始计数)
+     */
+    inline void EndLine(level::LEVEL level, uint64_t time) {
+      lines.push_back({level, data.size()});
+      max_level = std::max(max_level, level);
+      min_level = std::min(min_level, level);
+      levels |= static_cast<uint8_t>(1 << level);
+      min_time = std::min(min_time, time);
+      max_time = std::max(max_time, time);
+    }
+    /**
+     * 依次回调不低于 min 的各段连续行, 不拷贝内容
+     * @param min 最低等级
+     * @param func 以 (段内最高等级, 内容) 调用
+     */
+    template <typename Func>
+    void ForEachRun(level::LEVEL min, Func&& func) const {
+      std::string_view view(data);
+      if (min <= min_level) {
+        func(max_level, view);
+        return;
+      }
+      size_t begin = 0;
+      size_t run = std::string_view::npos;
+      auto run_level = level::DEBUG;
+      for (auto& i : lines) {
+        if (i.level >= min) {
+          if (run == std::string_view::npos) {
+            run = begin;
+            run_level = i.level;
+          }
+          run_level = std::max(run_level, i.level);
+        } else if (run != std::string_view::npos) {
+          func(run_level, view.substr(run, begin - run));
+          run = std::string_view::npos;
+        }
+        begin = i.end;
+      }
+      if (run != std::string_view::npos) func(run_level, view.substr(run, begin - run));
+    }
+  };
+  /**
+   * 文本输出端, 崩溃时作为 crash::SINK 阶段排空
+   */
+  class Item : public crash::Drainable {
    public:
     using Ptr = std::shared_ptr<Item>;
     virtual ~Item() = default;
-    virtual void operator<<(const std::string& str) = 0;
+    /**
+     * 写入一行已格式化的消息
+     * @param level 消息等级, 用于判断是否需要立即落盘
+     * @param str 格式化后的字符串
+     */
+    virtual void Write(level::LEVEL level, std::string_view str) = 0;
+    /**
+     * 写入一批消息中不低于 min 的行, 默认逐行调用 Write, 输出端可重写为按段写出
+     * 批次由同格式的各输出端共用, 输出端仅读取不持有
+     * @param batch 消息批次
+     * @param min 输出端最低等级
+     */
+    virtual void Write(const Batch& batch, level::LEVEL min) {
+      size_t begin = 0;
+      for (auto& i : batch.lines) {
+        if (i.level >= min) Write(i.level, std::string_view(batch.data).substr(begin, i.end - begin));
+        begin = i.end;
+      }
+    }
+    /**
+     * 将缓存中待写入的内容写出
+     */
+    virtual void Flush() {}
+    /**
+     * 崩溃时直接写出一行, 不经过缓存, 仅可调用异步信号安全的函数
+     * @param level 消息等级
+     * @param str 已格式化的一行
+     */
+    virtual void Emergency(level::LEVEL, std::string_view) {}
+    /**
+     * 设置统计, 用于记录落盘耗时
+     */
+    inline void set_metrics(Metrics* metrics) {
+      metrics_ = metrics;
+    }
+   protected:
+    Metrics* metrics_ = nullptr;
+  };
+  /**
+   * 文本输出端及其等级, format 为所用格式在 formats() 中的下标
+   */
+  struct Sink {
+    Item::Ptr item;
+    level::LEVEL level;
+    size_t format;
+  };
+  /**
+   * 去重后的格式, level 为使用该格式的输出端中的最低等级, 低于该等级的消息无需按此格式化
+   */
+  struct Format {
+    std::string pattern;
+    level::LEVEL level;
+  };
+  /**
+   * 二进制输出端, 直接写入消息原始数据, 由 log_decode 离线格式化
+   */
+  class Binary {
+   public:
+    using Ptr = std::shared_ptr<Binary>;
+    virtual ~Binary() = default;
+    virtual void Write(const Msg& msg) = 0;
+    virtual void Flush() {}
   };
  public:
-  explicit Outputter(const Config& cfg);
+  /**
+   * @param cfg 日志器配置
+   * @param metrics 日志器统计, 为空时不记录落盘耗时
+   */
+  explicit Outputter(const Config& cfg, Metrics* metrics = nullptr);
   ~Outputter();
-  inline Item::Ptr file() const {
-    return file_;
+  inline const std::vector<Sink>& sinks() const {
+    return sinks_;
+  }
+  inline const std::vector<Format>& formats() const {
+    return formats_;
   }
-  inline Item::Ptr console() const {
-    return console_;
+  inline Binary::Ptr binary() const {
+    return binary_;
   }
+  inline Item::Ptr json() const {
+    return json_;
+  }
+ private:
+  /**
+   * 添加文本输出端, 相同格式合并为一项
+   */
+  void AddSink(Item::Ptr item, level::LEVEL level, const std::string& pattern);
  private:
-  Item::Ptr file_;
-  Item::Ptr console_;
+  std::vector<Sink> sinks_;
+  std::vector<Format> formats_;
+  Binary::Ptr binary_;
+  Item::Ptr json_;
 };
 
 } // log
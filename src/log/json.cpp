@@ -0,0 +1,298 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 15:42:10
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 15:42:10
+ * @Description:
+ */
+
+#include "json.h"
+
+#include <ctime>
+#include <cmath>
+#include <cstring>
+#include <charconv>
+
+#include "logger.h"
+
+namespace tools {
+namespace log {
+namespace json {
+namespace {
+
+/**
+ * 依次读取已编码字段
+ */
+class FieldReader {
+ public:
+  explicit FieldReader(std::string_view data)
+      : data_(data) {}
+  inline bool AtEnd() const {
+    return offset_ >= data_.size();
+  }
+  bool Tag(field::TAG& tag) {
+    if (offset_ + 1 > data_.size()) return false;
+    tag = static_cast<field::TAG>(data_[offset_++]);
+    return true;
+  }
+  /**
+   * 查看下一个标记是否为 END, 是则跳过
+   */
+  bool End() {
+    if (offset_ < data_.size() && static_cast<field::TAG>(data_[offset_]) == field::END) {
+      ++offset_;
+      return true;
+    }
+    return false;
+  }
+  template <typename T>
+  bool Get(T& value) {
+    if (offset_ + sizeof(T) > data_.size()) return false;
+    memcpy(&value, data_.data() + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+  bool Str(std::string_view& str) {
+    uint32_t size;
+    if (!Get(size) || offset_ + size > data_.size()) return false;
+    str = data_.substr(offset_, size);
+    offset_ += size;
+    return true;
+  }
+ private:
+  std::string_view data_;
+  size_t offset_ = 0;
+};
+
+template <typename T>
+void AppendNumber(std::string& out, T value) {
+  char buffer[32];
+  auto res = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out.append(buffer, res.ptr - buffer);
+}
+
+void AppendDouble(std::string& out, double value) {
+  // JSON 不支持 NaN/Inf
+  if (!std::isfinite(value)) {
+    out.append("null", 4);
+    return;
+  }
+  AppendNumber(out, value);
+}
+
+/**
+ * 输出单个值, text 为 true 时标量字符串不加引号
+ */
+bool AppendValue(std::string& out, FieldReader& reader, bool text);
+
+bool AppendObject(std::string& out, FieldReader& reader) {
+  out.push_back('{');
+  for (bool first = true; !reader.End(); first = false) {
+    std::string_view key;
+    if (!reader.Str(key)) return false;
+    if (!first) out.push_back(',');
+    AppendString(out, key);
+    out.push_back(':');
+    if (!AppendValue(out, reader, false)) return false;
+  }
+  out.push_back('}');
+  return true;
+}
+
+bool AppendArray(std::string& out, FieldReader& reader) {
+  out.push_back('[');
+  for (bool first = true; !reader.End(); first = false) {
+    if (!first) out.push_back(',');
+    if (!AppendValue(out, reader, false)) return false;
+  }
+  out.push_back(']');
+  return true;
+}
+
+/**
+ * 文本形式下字符串是否需要加引号
+ */
+bool NeedQuote(std::string_view str) {
+  if (str.empty()) return true;
+  for (auto c : str) {
+    if (static_cast<unsigned char>(c) <= ' ' || c == '"' || c == '=' || c == '\\') return true;
+  }
+  return false;
+}
+
+bool AppendValue(std::string& out, FieldReader& reader, bool text) {
+  field::TAG tag;
+  if (!reader.Tag(tag)) return false;
+  switch (tag) {
+    case field::NUL:
+      out.append("null", 4);
+      return true;
+    case field::BOOL: {
+      uint8_t value;
+      if (!reader.Get(value)) return false;
+      if (value) out.append("true", 4); else out.append("false", 5);
+      return true;
+    }
+    case field::INT: {
+      int64_t value;
+      if (!reader.Get(value)) return false;
+      AppendNumber(out, value);
+      return true;
+    }
+    case field::UINT: {
+      uint64_t value;
+      if (!reader.Get(value)) return false;
+      AppendNumber(out, value);
+      return true;
+    }
+    case field::FLOAT: {
+      double value;
+      if (!reader.Get(value)) return false;
+      AppendDouble(out, value);
+      return true;
+    }
+    case field::STR: {
+      std::string_view str;
+      if (!reader.Str(str)) return false;
+      if (text && !NeedQuote(str)) {
+        out.append(str);
+      } else {
+        AppendString(out, str);
+      }
+      return true;
+    }
+    case field::OBJECT:
+      return AppendObject(out, reader);
+    case field::ARRAY:
+      return AppendArray(out, reader);
+    default:
+      return false;
+  }
+}
+
+const char* LevelName(level::LEVEL level) {
+  switch (level) {
+#define XX(LVL) \
+    case level::LVL: return #LVL;
+
+    XX(DEBUG)
+    XX(INFO)
+    XX(WARN)
+    XX(ERROR)
+    XX(FATAL)
+#undef XX
+    default: return "UNKNOWN";
+  }
+}
+
+/**
+ * 追加 UTC 时间 YYYY-mm-ddTHH:MM:SS.ffffffZ, 日期时间部分按秒缓存(每线程)
+ */
+void AppendTime(std::string& out, int64_t ns) {
+  static thread_local time_t cached_sec = -1;
+  static thread_local char cached[32];
+  static thread_local size_t cached_len = 0;
+  auto us = ns / 1000;
+  auto sec = static_cast<time_t>(us / 1000000);
+  auto fraction = us % 1000000;
+  if (fraction < 0) {
+    fraction += 1000000;
+    --sec;
+  }
+  if (sec != cached_sec) {
+    struct tm _tm{};
+#if _WIN32
+    gmtime_s(&_tm, &sec);
+#else
+    gmtime_r(&sec, &_tm);
+#endif
+    cached_len = std::strftime(cached, sizeof(cached), "%Y-%m-%dT%H:%M:%S", &_tm);
+    cached_sec = sec;
+  }
+  out.append(cached, cached_len);
+  char buffer[8] = {'.', '0', '0', '0', '0', '0', '0', 'Z'};
+  for (int i = 6; i > 0 && fraction; i--, fraction /= 10) {
+    buffer[i] = static_cast<char>('0' + fraction % 10);
+  }
+  out.append(buffer, sizeof(buffer));
+}
+
+} // namespace
+
+void AppendString(std::string& out, std::string_view str) {
+  static constexpr char k_hex[] = "0123456789abcdef";
+  out.push_back('"');
+  size_t begin = 0;
+  for (size_t i = 0; i < str.size(); i++) {
+    auto c = static_cast<unsigned char>(str[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') continue;
+    // 无需转义的部分整段追加
+    out.append(str.data() + begin, i - begin);
+    begin = i + 1;
+    switch (c) {
+      case '"': out.append("\\\"", 2); break;
+      case '\\': out.append("\\\\", 2); break;
+      case '\n': out.append("\\n", 2); break;
+      case '\r': out.append("\\r", 2); break;
+      case '\t': out.append("\\t", 2); break;
+      default: {
+        char buffer[6] = {'\\', 'u', '0', '0', k_hex[c >> 4], k_hex[c & 0xF]};
+        out.append(buffer, sizeof(buffer));
+      }
+    }
+  }
+  out.append(str.data() + begin, str.size() - begin);
+  out.push_back('"');
+}
+
+bool AppendFields(std::string& out, std::string_view fields) {
+  FieldReader reader(fields);
+  while (!reader.AtEnd()) {
+    std::string_view key;
+    if (!reader.Str(key)) return false;
+    out.push_back(',');
+    AppendString(out, key);
+    out.push_back(':');
+    if (!AppendValue(out, reader, false)) return false;
+  }
+  return true;
+}
+
+bool AppendText(std::string& out, std::string_view fields) {
+  FieldReader reader(fields);
+  while (!reader.AtEnd()) {
+    std::string_view key;
+    if (!reader.Str(key)) return false;
+    out.append(key);
+    out.push_back('=');
+    if (!AppendValue(out, reader, true)) return false;
+    out.push_back(' ');
+  }
+  return true;
+}
+
+void Encode(const Msg& msg, std::string_view logger, std::string& out) {
+  out.append("{\"time\":\"", 9);
+  AppendTime(out, msg.nanos());
+  out.append("\",\"level\":\"", 11);
+  out.append(LevelName(msg.level));
+  out.append("\",\"logger\":", 11);
+  AppendString(out, logger);
+  out.append(",\"file\":", 8);
+  AppendString(out, msg.site->base);
+  out.append(",\"line\":", 8);
+  AppendNumber(out, msg.site->line);
+  out.append(",\"func\":", 8);
+  AppendString(out, msg.site->func);
+  // 文本消息通常以换行结尾, JSON 中去除
+  std::string_view content = msg.content;
+  if (!content.empty() && content.back() == '\n') content.remove_suffix(1);
+  out.append(",\"msg\":", 7);
+  AppendString(out, content);
+  AppendFields(out, msg.fields);
+  out.append("}\n", 2);
+}
+
+} // json
+} // log
+} // tools
@@ -0,0 +1,59 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 15:42:10
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 15:42:10
+ * @Description: 流式 JSON 编码, 直接追加至输出缓存, 不构建中间对象
+ */
+
+#ifndef TOOLS_LOG_JSON_H_
+#define TOOLS_LOG_JSON_H_
+
+#include <string>
+#include <string_view>
+
+namespace tools {
+namespace log {
+
+struct Msg;
+
+namespace json {
+
+/**
+ * 追加带引号的 JSON 字符串, 转义引号/反斜杠/控制字符, 其余字节原样输出
+ * @param out 输出缓存
+ * @param str 字符串
+ */
+void AppendString(std::string& out, std::string_view str);
+
+/**
+ * 将已编码的结构化字段以 ,"key":value 的形式追加, 用于拼接至已有对象之后
+ * @param out 输出缓存
+ * @param fields 已编码字段
+ * @return 字段不完整时返回 false, 已输出的部分保留
+ */
+bool AppendFields(std::string& out, std::string_view fields);
+
+/**
+ * 将已编码的结构化字段以 key=value 的形式追加, 每个字段后跟一个空格
+ * 含空白或引号的字符串以 JSON 字符串输出, 对象及数组以 JSON 输出
+ * @param out 输出缓存
+ * @param fields 已编码字段
+ * @return 字段不完整时返回 false, 已输出的部分保留
+ */
+bool AppendText(std::string& out, std::string_view fields);
+
+/**
+ * 将消息编码为单行 JSON 对象(JSON Lines), 以换行结尾
+ * {"time":"...","level":"INFO","logger":"...","file":"...","line":1,"func":"...","msg":"...",<fields>}
+ * @param msg 消息
+ * @param logger 日志器名称
+ * @param out 输出缓存
+ */
+void Encode(const Msg& msg, std::string_view logger, std::string& out);
+
+} // json
+} // log
+} // tools
+
+#endif //TOOLS_LOG_JSON_H_
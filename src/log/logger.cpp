@@ -8,7 +8,11 @@
 
 #include "logger.h"
 
-#include <sstream>
+#include <algorithm>
+
+#include "json.h"
+#include "binary.h"
+#include "worker.h"
 
 // 默认日志器格式
 #define LOGGER_DEF_PATTERN        "%d <%p> [%f:%l] [%c] %m"
@@ -17,77 +21,360 @@
 
 namespace tools {
 namespace log {
+namespace {
+
+/**
+ * 检查已登记采样调用点的间隔
+ */
+constexpr std::chrono::milliseconds k_sweep_interval{1000};
+
+} // namespace
 
 Logger::Logger(const Config& cfg)
-    : cfg_(new Config(cfg)),
-      formatter_(new Formatter()),
-      outputter_(new Outputter(cfg)){
-  formatter_->Parse(cfg_->pattern);
+    : level_(cfg.minLevel),
+      cfg_(new Config(cfg)),
+      outputter_(new Outputter(cfg, &metrics_)){
+  for (auto& i : outputter_->formats()) {
+    formatters_.emplace_back(new Formatter());
+    formatters_.back()->Parse(i.pattern);
+  }
 }
 
 Logger::~Logger() = default;
 
-void Logger::operator()(const Msg::Ptr& msg) {
-  // 格式器不存在时 OR 小于最低等级时忽略输出
-  if (!formatter_ || msg->level < Mgr::GetInstance().level()) return;
-  std::ostringstream oss;
-  for (auto& i : formatter_->pattern()) {
-    oss << (*i)(*msg);
+void Logger::operator()(Msg& msg) {
+  (*this)(&msg, 1);
+}
+
+void Logger::operator()(Msg* msgs, size_t count) {
+  auto min_level = std::max(Mgr::GetInstance().level(), level());
+  auto& formats = outputter_->formats();
+  auto json = outputter_->json();
+  auto& shard = metrics_.Local();
+  auto start = std::chrono::steady_clock::now();
+  size_t accepted = 0;
+  // 每个线程复用同一组缓存, 容量稳定后格式化不再分配内存; 每种格式一个批次, 由同格式的输出端共用
+  static thread_local std::vector<Outputter::Batch> batches;
+  static thread_local Outputter::Batch json_batch;
+  static thread_local std::string rendered;
+  if (batches.size() < formats.size()) batches.resize(formats.size());
+  for (size_t i = 0; i < formats.size(); i++) {
+    batches[i].Clear();
+  }
+  json_batch.Clear();
+  for (size_t i = 0; i < count; i++) {
+    auto& msg = msgs[i];
+    // 小于最低等级时忽略输出
+    if (msg.level < min_level) {
+      shard.filtered.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    ++accepted;
+    // 二进制输出端直接写入原始参数, 无需格式化
+    if (outputter_->binary()) {
+      outputter_->binary()->Write(msg);
+    }
+    if (formats.empty() && !json) continue;
+    if (msg.deferred()) {
+      rendered.clear();
+      bin::Render(msg.site->format, msg.args, rendered);
+      msg.content = rendered;
+    }
+    // 仅按有输出端需要的格式格式化
+    for (size_t f = 0; f < formats.size(); f++) {
+      if (msg.level < formats[f].level) continue;
+      formatters_[f]->Format(msg, batches[f].data);
+      batches[f].EndLine(msg.level, msg.time);
+    }
+    if (json) {
+      json::Encode(msg, cfg_->name, json_batch.data);
+      json_batch.EndLine(msg.level, msg.time);
+    }
+  }
+  if (!accepted) return;
+  shard.format.Record(Metrics::Elapsed(start) / accepted, accepted);
+  shard.messages.fetch_add(accepted, std::memory_order_relaxed);
+  auto bytes = json_batch.data.size();
+  for (size_t i = 0; i < formats.size(); i++) {
+    bytes += batches[i].data.size();
+  }
+  shard.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  if (!json_batch.lines.empty()) {
+    Metrics::Timer timer(&shard.write);
+    json->Write(json_batch, level::DEBUG);
+  }
+  for (auto& i : outputter_->sinks()) {
+    auto& batch = batches[i.format];
+    if (batch.lines.empty() || batch.max_level < i.level) continue;
+    Metrics::Timer timer(&shard.write);
+    i.item->Write(batch, i.level);
+  }
+}
+
+void Logger::Flush() {
+  for (auto& i : outputter_->sinks()) {
+    i.item->Flush();
   }
-  if (outputter_->console()) {
-    (*outputter_->console()) << oss.str();
+  if (outputter_->binary()) {
+    outputter_->binary()->Flush();
   }
-  if (outputter_->file()) {
-    (*outputter_->file()) << oss.str();
+  if (outputter_->json()) {
+    outputter_->json()->Flush();
+  }
+}
+
+void Logger::Emergency(level::LEVEL level, std::string_view str) {
+  for (auto& i : outputter_->sinks()) {
+    if (level >= i.level) i.item->Emergency(level, str);
   }
 }
 
 LoggerMgr::LoggerMgr()
-    : def_logger_(new Logger(LOGGER_DEF_CONFIG("root"))) {}
+    : def_logger_(new Logger(LOGGER_DEF_CONFIG("root"))) {
+  map_pool_.emplace_back(new SlotMap());
+  slots_.store(map_pool_.back().get(), std::memory_order_release);
+}
 
-LoggerMgr::~LoggerMgr() = default;
+LoggerMgr::~LoggerMgr() {
+  {
+    std::lock_guard<std::mutex> lk(report_mutex_);
+    report_stop_ = true;
+  }
+  report_cv_.notify_all();
+  if (reporter_) reporter_->Join();
+  // 先停止写线程, 保证队列中的消息在日志器析构前输出
+  DisableAsync();
+}
 
 bool LoggerMgr::Register(const Config& cfg) {
   std::lock_guard<std::mutex> lk(mutex_);
-  if (loggers_.count(cfg.name)) {
+  auto slot = SlotLocked(cfg.name);
+  if (slot->logger.load(std::memory_order_relaxed)) {
     return false;
   }
-  auto logger = std::make_shared<Logger>(cfg);
-  loggers_.insert({cfg.name, logger});
+  logger_pool_.emplace_back(new Logger(cfg));
+  slot->logger.store(logger_pool_.back().get(), std::memory_order_release);
+  UpdateLevels();
   return true;
 }
 
 bool LoggerMgr::Register(const std::string &name) {
+  return Register(Config LOGGER_DEF_CONFIG(name));
+}
+
+void LoggerMgr::Unregister(const std::string &key) {
   std::lock_guard<std::mutex> lk(mutex_);
-  if (loggers_.count(name)) {
+  auto slots = slots_.load(std::memory_order_acquire);
+  auto res = slots->find(key);
+  if (res == slots->end()) return;
+  // 槽位及日志器保留, 之后的输出交予默认日志器; 已打开的文件在管理器析构前不关闭
+  auto logger = res->second->logger.exchange(nullptr, std::memory_order_acq_rel);
+  if (logger) logger->Flush();
+  UpdateLevels();
+}
+
+LoggerSlot* LoggerMgr::Slot(const std::string& key) {
+  {
+    auto slots = slots_.load(std::memory_order_acquire);
+    auto res = slots->find(key);
+    if (res != slots->end()) return res->second;
+  }
+  std::lock_guard<std::mutex> lk(mutex_);
+  return SlotLocked(key);
+}
+
+LoggerSlot* LoggerMgr::SlotLocked(const std::string& key) {
+  auto slots = slots_.load(std::memory_order_acquire);
+  auto res = slots->find(key);
+  if (res != slots->end()) return res->second;
+  // 复制快照后插入新槽位, 再整体替换, 读者始终看到完整的快照
+  slot_pool_.emplace_back(new LoggerSlot(key));
+  auto slot = slot_pool_.back().get();
+  slot->level.store(std::max(level(), def_logger_->level()), std::memory_order_relaxed);
+  auto copy = std::make_unique<SlotMap>(*slots);
+  copy->insert({key, slot});
+  slots_.store(copy.get(), std::memory_order_release);
+  map_pool_.push_back(std::move(copy));
+  return slot;
+}
+
+void LoggerMgr::Output(LoggerSlot* slot, Msg& msg) {
+  auto logger = Resolve(slot);
+  // 小于生效等级时直接忽略, 不进入队列
+  if (msg.level < slot->level.load(std::memory_order_relaxed)) {
+    logger->metrics().Local().filtered.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // FATAL 同步输出: 先排空队列保证顺序, 写出后立即落盘
+  if (msg.level >= level::FATAL) {
+    Flush();
+    (*logger)(msg);
+    Flush();
+    return;
+  }
+  auto worker = worker_.load(std::memory_order_acquire);
+  // 异步模式下仅入队, 写线程已停止时回退为同步输出
+  if (worker && worker->Push(logger, msg)) return;
+  (*logger)(msg);
+}
+
+void LoggerMgr::set_level(level::LEVEL level) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  level_.store(level, std::memory_order_relaxed);
+  UpdateLevels();
+}
+
+bool LoggerMgr::SetLevel(const std::string& key, level::LEVEL level) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  auto logger = def_logger_.get();
+  if (!key.empty()) {
+    auto slots = slots_.load(std::memory_order_acquire);
+    auto res = slots->find(key);
+    if (res == slots->end()) {
+      return false;
+    }
+    logger = res->second->logger.load(std::memory_order_acquire);
+    if (!logger) {
+      return false;
+    }
+  }
+  logger->set_level(level);
+  UpdateLevels();
+  return true;
+}
+
+void LoggerMgr::UpdateLevels() {
+  auto global = level();
+  // 实际生效等级为日志器自身等级与全局等级中的较高者
+  for (auto& i : slot_pool_) {
+    auto logger = Resolve(i.get());
+    i->level.store(std::max(global, logger->level()), std::memory_order_relaxed);
+  }
+}
+
+bool LoggerMgr::EnableAsync(const AsyncConfig& cfg) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (worker_.load(std::memory_order_relaxed)) {
     return false;
   }
-  auto logger = std::make_shared<Logger>(Config LOGGER_DEF_CONFIG(name));
-  loggers_.insert({name, logger});
+  workers_.emplace_back(new Worker(cfg));
+  worker_.store(workers_.back().get(), std::memory_order_release);
   return true;
 }
 
-void LoggerMgr::Unregister(const std::string &key) {
+void LoggerMgr::DisableAsync() {
   std::lock_guard<std::mutex> lk(mutex_);
-  loggers_.erase(key);
+  auto worker = worker_.exchange(nullptr, std::memory_order_acq_rel);
+  if (worker) worker->Stop();
+}
+
+void LoggerMgr::Flush() {
+  auto worker = worker_.load(std::memory_order_acquire);
+  if (worker) worker->Flush();
+  // 队列清空后再将各日志器缓存的内容统一落盘
+  def_logger_->Flush();
+  auto slots = slots_.load(std::memory_order_acquire);
+  for (auto& i : *slots) {
+    auto logger = i.second->logger.load(std::memory_order_acquire);
+    if (logger) logger->Flush();
+  }
+}
+
+Stats LoggerMgr::GetStats() {
+  Stats stats;
+  auto add = [&](Logger* logger) {
+    LoggerStats item;
+    item.name = logger->cfg()->name;
+    logger->metrics().Snapshot(item);
+    stats.loggers.push_back(std::move(item));
+  };
+  add(def_logger_.get());
+  auto slots = slots_.load(std::memory_order_acquire);
+  for (auto& i : *slots) {
+    auto logger = i.second->logger.load(std::memory_order_acquire);
+    if (logger) add(logger);
+  }
+  // 默认日志器在前, 其余按名称排序
+  std::sort(stats.loggers.begin() + 1, stats.loggers.end(), [](auto& a, auto& b) {
+    return a.name < b.name;
+  });
+  auto worker = worker_.load(std::memory_order_acquire);
+  if (worker) stats.queueDepth = worker->Depth();
+  return stats;
 }
 
-void LoggerMgr::Output(const std::string& key, Msg::Ptr msg) {
-  auto res = loggers_.find(key);
-  // 未找到交予默认日志器输出
-  if (res == loggers_.end()) {
-    (*def_logger_)(msg);
-  } else {
-    (*(res->second))(msg);
+void LoggerMgr::SetStatsReportInterval(uint32_t ms) {
+  {
+    std::lock_guard<std::mutex> lk(report_mutex_);
+    report_interval_ = ms;
+    if (ms && !reporter_) {
+      reporter_ = std::make_unique<async::Thread>("log.stats", &LoggerMgr::ReportLoop, this);
+    }
+  }
+  report_cv_.notify_all();
+}
+
+void LoggerMgr::Watch(sample::Site* site, const CallSite* call_site, LoggerSlot* slot) {
+  {
+    std::lock_guard<std::mutex> lk(report_mutex_);
+    watched_.push_back({site, call_site, slot});
+    if (!reporter_) {
+      reporter_ = std::make_unique<async::Thread>("log.stats", &LoggerMgr::ReportLoop, this);
+    }
+  }
+  report_cv_.notify_all();
+}
+
+void LoggerMgr::ReportLoop() {
+  crash::InstallThreadStack();
+  std::unique_lock<std::mutex> lk(report_mutex_);
+  auto interval = report_interval_;
+  auto report_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+  while (!report_stop_) {
+    // 间隔被修改时按新间隔重新计时
+    if (report_interval_ != interval) {
+      interval = report_interval_;
+      report_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+    }
+    if (!interval && watched_.empty()) {
+      report_cv_.wait(lk);
+      continue;
+    }
+    // 采样调用点按 k_sweep_interval 检查, 汇总最迟在到期后该时间内输出
+    auto wake = watched_.empty() ? std::chrono::steady_clock::time_point::max()
+                                 : std::chrono::steady_clock::now() + k_sweep_interval;
+    if (interval) wake = std::min(wake, report_at);
+    if (report_cv_.wait_until(lk, wake, [&]{ return report_stop_ || report_interval_ != interval; })) {
+      continue;
+    }
+    auto now = std::chrono::steady_clock::now();
+    bool report = interval && now >= report_at;
+    if (report) report_at = now + std::chrono::milliseconds(interval);
+    auto watched = watched_;
+    lk.unlock();
+    for (auto& i : watched) {
+      i.site->Expire(LoggerHandle(i.slot->name()), *i.call_site);
+    }
+    if (report) {
+      auto stats = GetStats();
+      for (auto& i : stats.loggers) {
+        LOG_FMT("stats logger={} messages={} bytes={} dropped={} filtered={} format_p99={}ns write_p99={}ns "
+                "sync_p99={}ns queue={}\n", i.name, i.messages, i.bytes, i.dropped, i.filtered,
+                i.format.Percentile(99), i.write.Percentile(99), i.sync.Percentile(99), stats.queueDepth)
+            .With("logger", i.name).With("messages", i.messages).With("bytes", i.bytes).With("dropped", i.dropped);
+      }
+    }
+    lk.lock();
   }
 }
 
 std::vector<std::weak_ptr<Config> > LoggerMgr::GetAllLoggers() {
-  std::lock_guard<std::mutex> lk(mutex_);
+  auto slots = slots_.load(std::memory_order_acquire);
   std::vector<std::weak_ptr<Config> > cfgs;
-  cfgs.reserve(loggers_.size());
-  for (auto& i : loggers_) {
-    cfgs.push_back(i.second->cfg());
+  cfgs.reserve(slots->size());
+  for (auto& i : *slots) {
+    auto logger = i.second->logger.load(std::memory_order_acquire);
+    if (logger) cfgs.push_back(logger->cfg());
   }
   return cfgs;
 }
@@ -10,29 +10,49 @@
 #define TOOLS_LOG_LOGGER_H_
 
 #include <mutex>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <vector>
 #include <unordered_map>
+#include <condition_variable>
 
+#include <async.h>
 #include <pattern.hpp>
 
 #include "log.h"
 #include "formatter.h"
 #include "io.h"
+#include "metrics.h"
 
 namespace tools {
 namespace log {
 
+class Worker;
+
 /**
  * 日志消息体, 用于组合传递参数
  */
 struct Msg {
-  using Ptr = std::shared_ptr<Msg>;
-  time_t time;          // 时间戳
-  const char* file;     // 文件名
-  const char* func;     // 函数名
-  uint64_t line;        // 行号
-  level::LEVEL level;   // 等级枚举
-  std::string content;  // 内容
+  uint64_t time;           // 时间戳, tick::Now() 的原始计数
+  const CallSite* site;    // 调用点, 文件/函数/行号均取自此处
+  level::LEVEL level;      // 等级枚举
+  LogBuffer content;       // 内容, 短消息内联存放
+  std::string args = {};   // 二进制日志的已编码参数
+  std::string fields = {}; // 已编码的结构化字段
+  bool wall = false;       // time 已是墙上时间(纳秒), 如从二进制日志解码的消息
+  /**
+   * 墙上时间, 自 1970-01-01 起的纳秒数
+   */
+  inline int64_t nanos() const {
+    return wall ? static_cast<int64_t>(time) : tick::ToNanos(time);
+  }
+  /**
+   * 二进制日志尚未展开参数
+   */
+  inline bool deferred() const {
+    return site->format && content.empty();
+  }
 };
 
 class Logger {
@@ -41,16 +61,76 @@ class Logger {
  public:
   explicit Logger(const Config& cfg);
   ~Logger();
-  void operator()(const Msg::Ptr& msg);
+  /**
+   * 输出消息, 二进制日志的参数在此展开(异步模式下即写线程)
+   * @param msg 日志消息
+   */
+  void operator()(Msg& msg);
+  /**
+   * 批量输出消息, 每种格式仅格式化一次, 全部格式化后每个输出端仅写出一次
+   * @param msgs 消息数组
+   * @param count 消息数
+   */
+  void operator()(Msg* msgs, size_t count);
+  /**
+   * 将各输出端缓存的内容写出
+   */
+  void Flush();
+  /**
+   * 崩溃时将已格式化的一行直接写至等级满足的文本输出端
+   */
+  void Emergency(level::LEVEL level, std::string_view str);
   inline std::shared_ptr<Config> cfg() const {
     return cfg_;
   }
+  /**
+   * 日志器自身的最低输出等级, 初始值取自 Config::minLevel
+   */
+  inline level::LEVEL level() const {
+    return level_.load(std::memory_order_relaxed);
+  }
+  inline void set_level(level::LEVEL level) {
+    level_.store(level, std::memory_order_relaxed);
+  }
+  inline Metrics& metrics() {
+    return metrics_;
+  }
  private:
+  std::atomic<level::LEVEL> level_;
   std::shared_ptr<Config> cfg_;
-  std::unique_ptr<Formatter> formatter_;
+  /**
+   * 与 Outputter::formats() 一一对应的格式器
+   */
+  std::vector<std::unique_ptr<Formatter> > formatters_;
+  /**
+   * 运行统计, 输出端析构时仍会记录落盘耗时, 需先于 outputter_ 构造
+   */
+  Metrics metrics_;
   std::unique_ptr<Outputter> outputter_;
 };
 
+/**
+ * 日志器槽位, 与名称一一对应且创建后不再释放, 句柄直接持有其地址
+ */
+class LoggerSlot {
+ public:
+  explicit LoggerSlot(std::string name)
+      : name_(std::move(name)) {}
+  inline const std::string& name() const {
+    return name_;
+  }
+  /**
+   * 实际生效等级, 为日志器自身等级与全局等级中的较高者
+   */
+  std::atomic<uint8_t> level{log::level::DEBUG};
+  /**
+   * 已注册的日志器, 为空时交予默认日志器输出; 日志器由管理器持有, 读取无需引用计数
+   */
+  std::atomic<Logger*> logger{nullptr};
+ private:
+  const std::string name_;
+};
+
 /**
  * 日志管理器
  */
@@ -76,11 +156,18 @@ class LoggerMgr {
    */
   void Unregister(const std::string& key);
   /**
-   * 寻找指定日志器并调用输出
+   * 获取名称对应的槽位, 不存在时创建
+   * 查找读取快照无需加锁, 仅在创建时加锁并替换快照
    * @param key 日志器名称
+   * @return 槽位
+   */
+  LoggerSlot* Slot(const std::string& key);
+  /**
+   * 调用槽位对应的日志器输出, 异步模式下消息被移入队列
+   * @param slot 日志器槽位
    * @param msg 日志消息
    */
-  void Output(const std::string& key, Msg::Ptr msg);
+  void Output(LoggerSlot* slot, Msg& msg);
   /**
    * 获取所有已注册日志器配置
    * @return 日志器配置数组
@@ -90,31 +177,125 @@ class LoggerMgr {
    * 设置全局输出最低等级
    * @param level 等级枚举
    */
-  inline void set_level(level::LEVEL level) {
-    level_ = level;
-  }
+  void set_level(level::LEVEL level);
   /**
    * 获取全局输出最低等级
    * @return 等级枚举
    */
-  auto level() const {
-    return level_;
+  inline level::LEVEL level() const {
+    return level_.load(std::memory_order_relaxed);
   }
+  /**
+   * 设置指定日志器的最低输出等级
+   * @param key 日志器名称, 为空时对应默认日志器
+   * @param level 等级枚举
+   * @return 日志器不存在时返回失败
+   */
+  bool SetLevel(const std::string& key, level::LEVEL level);
+  /**
+   * 开启异步输出
+   * @param cfg 异步输出配置
+   * @return 已开启时返回失败
+   */
+  bool EnableAsync(const AsyncConfig& cfg);
+  /**
+   * 关闭异步输出, 返回前输出队列中剩余消息
+   */
+  void DisableAsync();
+  /**
+   * 等待已提交的消息输出完毕, 并将各日志器缓存的内容落盘
+   */
+  void Flush();
+  /**
+   * 汇总默认日志器及所有已注册日志器的统计
+   * @return 统计快照
+   */
+  Stats GetStats();
+  /**
+   * 设置周期性输出统计的间隔, 首次开启时创建输出线程
+   * @param ms 间隔(毫秒), 0 为关闭
+   */
+  void SetStatsReportInterval(uint32_t ms);
+  /**
+   * 登记出现过抑制的采样调用点, 由统计线程周期性输出其到期未汇总的条数, 首次登记时创建输出线程
+   * @param site 采样状态, 为调用点的静态变量
+   * @param call_site 调用点
+   * @param slot 日志器槽位
+   */
+  void Watch(sample::Site* site, const CallSite* call_site, LoggerSlot* slot);
+
+ private:
+  using SlotMap = std::unordered_map<std::string, LoggerSlot*>;
+  /**
+   * 槽位的实际日志器, 未注册时为默认日志器
+   */
+  inline Logger* Resolve(LoggerSlot* slot) const {
+    auto logger = slot->logger.load(std::memory_order_acquire);
+    return logger ? logger : def_logger_.get();
+  }
+  /**
+   * 获取或创建槽位, 需持有 mutex_
+   */
+  LoggerSlot* SlotLocked(const std::string& key);
+  /**
+   * 重新计算所有槽位的实际生效等级, 需持有 mutex_
+   */
+  void UpdateLevels();
+  /**
+   * 统计输出线程主循环, 同时汇总已登记的采样调用点
+   */
+  void ReportLoop();
 
  private:
   std::mutex mutex_;
+  /**
+   * 默认日志器
+   */
+  std::unique_ptr<Logger> def_logger_;
+  /**
+   * 创建过的日志器, 生命周期与管理器一致, 反注册后仍保留(含已打开的文件),
+   * 生产者及队列中的消息可直接持有其地址; 需先于写线程构造, 写线程析构时仍会输出
+   */
+  std::vector<std::unique_ptr<Logger> > logger_pool_;
+  /**
+   * 当前异步写线程, 为空时同步输出
+   */
+  std::atomic<Worker*> worker_{nullptr};
+  /**
+   * 创建过的写线程, 生命周期与管理器一致, 避免关闭时与生产者竞争
+   */
+  std::vector<std::unique_ptr<Worker> > workers_;
   /**
    * 全局输出最最低等级, 默认为 DEBUG
    */
-  level::LEVEL level_ = level::DEBUG;
+  std::atomic<level::LEVEL> level_{level::DEBUG};
   /**
-   * 日志器集合
+   * 名称至槽位的只读快照, 修改时复制后整体替换(copy-on-write)
+   * 旧快照保留至管理器析构, 读取方无需引用计数
    */
-  std::unordered_map<std::string, Logger::Ptr> loggers_;
+  std::atomic<const SlotMap*> slots_{nullptr};
+  std::vector<std::unique_ptr<const SlotMap> > map_pool_;
   /**
-   * 默认日志器
+   * 槽位所有权, 仅在持有 mutex_ 时修改
+   */
+  std::vector<std::unique_ptr<LoggerSlot> > slot_pool_;
+  /**
+   * 统计输出线程, 使用独立的锁, 输出时不持有 mutex_
+   */
+  std::mutex report_mutex_;
+  std::condition_variable report_cv_;
+  uint32_t report_interval_ = 0;
+  bool report_stop_ = false;
+  std::unique_ptr<async::Thread> reporter_;
+  /**
+   * 已登记的采样调用点, 只增不减, 由 report_mutex_ 保护
    */
-  Logger::Ptr def_logger_;
+  struct Watched {
+    sample::Site* site;
+    const CallSite* call_site;
+    LoggerSlot* slot;
+  };
+  std::vector<Watched> watched_;
 };
 
 using Mgr = pattern::HungrySingleton<LoggerMgr>;
@@ -0,0 +1,54 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 16:25:37
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 16:25:37
+ * @Description:
+ */
+
+#include "metrics.h"
+
+#include <bit>
+#include <algorithm>
+
+namespace tools {
+namespace log {
+
+void Metrics::Recorder::Record(uint64_t ns, uint64_t count) {
+  auto bucket = std::min<size_t>(std::bit_width(ns), Histogram::k_buckets - 1);
+  count_.fetch_add(count, std::memory_order_relaxed);
+  sum_.fetch_add(ns * count, std::memory_order_relaxed);
+  buckets_[bucket].fetch_add(count, std::memory_order_relaxed);
+  auto max = max_.load(std::memory_order_relaxed);
+  while (ns > max && !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+void Metrics::Recorder::MergeTo(Histogram& out) const {
+  out.count += count_.load(std::memory_order_relaxed);
+  out.sum += sum_.load(std::memory_order_relaxed);
+  out.max = std::max(out.max, max_.load(std::memory_order_relaxed));
+  for (size_t i = 0; i < Histogram::k_buckets; i++) {
+    out.buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+  }
+}
+
+Metrics::Shard& Metrics::Local() {
+  static std::atomic<size_t> next{0};
+  static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % k_shards;
+  return shards_[index];
+}
+
+void Metrics::Snapshot(LoggerStats& stats) const {
+  for (auto& i : shards_) {
+    stats.messages += i.messages.load(std::memory_order_relaxed);
+    stats.bytes += i.bytes.load(std::memory_order_relaxed);
+    stats.dropped += i.dropped.load(std::memory_order_relaxed);
+    stats.filtered += i.filtered.load(std::memory_order_relaxed);
+    i.format.MergeTo(stats.format);
+    i.write.MergeTo(stats.write);
+    i.sync.MergeTo(stats.sync);
+  }
+}
+
+} // log
+} // tools
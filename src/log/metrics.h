@@ -0,0 +1,96 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 16:25:37
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 16:25:37
+ * @Description: 日志器自身的运行统计, 按线程分片计数, 读取时汇总
+ */
+
+#ifndef TOOLS_LOG_METRICS_H_
+#define TOOLS_LOG_METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <log.h>
+
+namespace tools {
+namespace log {
+
+class Metrics {
+ public:
+  /**
+   * 分片数, 线程按首次使用的顺序轮流分配至各分片
+   */
+  static constexpr size_t k_shards = 8;
+  /**
+   * 可并发记录的直方图
+   */
+  class Recorder {
+   public:
+    /**
+     * 记录 count 个耗时均为 ns 的样本, 批量操作以平均值按条数计入
+     */
+    void Record(uint64_t ns, uint64_t count = 1);
+    /**
+     * 累加至统计结果
+     */
+    void MergeTo(Histogram& out) const;
+   private:
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+    std::atomic<uint64_t> buckets_[Histogram::k_buckets] = {};
+  };
+  /**
+   * 单个分片, 独占缓存行避免线程间伪共享
+   */
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> filtered{0};
+    Recorder format;
+    Recorder write;
+    Recorder sync;
+  };
+  /**
+   * 计时器, 析构时记录经过的时间
+   */
+  class Timer {
+   public:
+    explicit Timer(Recorder* recorder)
+        : recorder_(recorder),
+          start_(recorder ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+    ~Timer() {
+      if (recorder_) recorder_->Record(Elapsed(start_));
+    }
+   private:
+    Recorder* recorder_;
+    std::chrono::steady_clock::time_point start_;
+  };
+ public:
+  /**
+   * 当前线程对应的分片
+   */
+  Shard& Local();
+  /**
+   * 汇总所有分片至统计结果, 名称由调用者填写
+   */
+  void Snapshot(LoggerStats& stats) const;
+  /**
+   * 自 start 起经过的纳秒数
+   */
+  static inline uint64_t Elapsed(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+ private:
+  Shard shards_[k_shards];
+};
+
+} // log
+} // tools
+
+#endif //TOOLS_LOG_METRICS_H_
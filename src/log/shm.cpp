@@ -0,0 +1,244 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 19:05:44
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 19:05:44
+ * @Description:
+ */
+
+#include "shm.h"
+
+#if __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <thread>
+#include <cstring>
+#include <algorithm>
+
+namespace tools {
+namespace log {
+namespace shm {
+namespace {
+
+/**
+ * 记录未写完超过该时间时视为写入方已崩溃
+ */
+constexpr auto k_stall = std::chrono::seconds(1);
+
+/**
+ * 其他进程正在创建段时的最长等待时间
+ */
+constexpr auto k_init_wait = std::chrono::seconds(1);
+
+constexpr size_t k_min_capacity = 4096;
+
+inline uint64_t Align(uint64_t size) {
+  return (size + 7) & ~uint64_t(7);
+}
+
+inline uint64_t Pack(uint64_t pos, size_t length, uint8_t level) {
+  return static_cast<uint32_t>(pos >> 3) | static_cast<uint64_t>(length) << 32 | static_cast<uint64_t>(level) << 56;
+}
+
+inline bool Tagged(uint64_t word, uint64_t pos) {
+  return static_cast<uint32_t>(word) == static_cast<uint32_t>(pos >> 3);
+}
+
+inline size_t Length(uint64_t word) {
+  return static_cast<size_t>((word >> 32) & k_max_length);
+}
+
+inline uint8_t Level(uint64_t word) {
+  return static_cast<uint8_t>(word >> 56);
+}
+
+} // namespace
+
+struct Ring::Layout {
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint64_t capacity;
+  alignas(64) std::atomic<uint64_t> reserve;
+  alignas(64) std::atomic<uint64_t> read;
+  alignas(64) std::atomic<uint64_t> dropped;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm ring requires lock-free 64-bit atomics");
+
+Ring::~Ring() {
+  Close();
+}
+
+bool Ring::Open(const std::string& name, size_t capacity) {
+  Close();
+#if __unix__
+  // 数据区紧随头部, 需按 word 对齐
+  static_assert(sizeof(Layout) % 64 == 0);
+  size_t size = k_min_capacity;
+  while (size < capacity) size <<= 1;
+  // 优先独占创建, 已存在时打开并等待创建者完成初始化
+  bool created = false;
+  int fd = -1;
+  if (capacity) {
+    fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    created = fd >= 0;
+  }
+  if (fd < 0) fd = shm_open(name.c_str(), O_RDWR, 0644);
+  if (fd < 0) return false;
+  if (created && ftruncate(fd, static_cast<off_t>(sizeof(Layout) + size)) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+  struct stat st{};
+  auto deadline = std::chrono::steady_clock::now() + k_init_wait;
+  while (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) < sizeof(Layout) &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (static_cast<size_t>(st.st_size) <= sizeof(Layout)) {
+    close(fd);
+    return false;
+  }
+  auto mapped = static_cast<size_t>(st.st_size);
+  auto addr = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return false;
+  auto layout = static_cast<Layout*>(addr);
+  if (created) {
+    layout->version = k_version;
+    layout->capacity = size;
+    layout->reserve.store(0, std::memory_order_relaxed);
+    layout->read.store(0, std::memory_order_relaxed);
+    layout->dropped.store(0, std::memory_order_relaxed);
+    layout->magic.store(k_magic, std::memory_order_release);
+  } else {
+    while (layout->magic.load(std::memory_order_acquire) != k_magic &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (layout->magic.load(std::memory_order_acquire) != k_magic || layout->version != k_version ||
+        layout->capacity + sizeof(Layout) > mapped || (layout->capacity & (layout->capacity - 1))) {
+      munmap(addr, mapped);
+      return false;
+    }
+  }
+  layout_ = layout;
+  data_ = static_cast<char*>(addr) + sizeof(Layout);
+  capacity_ = layout->capacity;
+  mapped_ = mapped;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Ring::Close() {
+  if (!layout_) return;
+#if __unix__
+  munmap(layout_, mapped_);
+#endif
+  layout_ = nullptr;
+  data_ = nullptr;
+  capacity_ = 0;
+  mapped_ = 0;
+}
+
+bool Ring::Remove(const std::string& name) {
+#if __unix__
+  return shm_unlink(name.c_str()) == 0;
+#else
+  return false;
+#endif
+}
+
+std::atomic_ref<uint64_t> Ring::Word(uint64_t pos) const {
+  return std::atomic_ref<uint64_t>(*reinterpret_cast<uint64_t*>(data_ + (pos & (capacity_ - 1))));
+}
+
+void Ring::CopyIn(uint64_t pos, std::string_view str) {
+  auto offset = pos & (capacity_ - 1);
+  auto n = std::min<size_t>(str.size(), capacity_ - offset);
+  memcpy(data_ + offset, str.data(), n);
+  memcpy(data_, str.data() + n, str.size() - n);
+}
+
+std::string_view Ring::View(uint64_t pos, size_t size) {
+  auto offset = pos & (capacity_ - 1);
+  if (offset + size <= capacity_) return {data_ + offset, size};
+  auto n = capacity_ - offset;
+  scratch_.assign(data_ + offset, n);
+  scratch_.append(data_, size - n);
+  return scratch_;
+}
+
+bool Ring::Write(level::LEVEL level, std::string_view str) {
+  if (!layout_) return false;
+  auto size = Align(8 + str.size());
+  if (str.size() > k_max_length || size > capacity_) {
+    layout_->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  auto pos = layout_->reserve.load(std::memory_order_relaxed);
+  do {
+    if (pos + size - layout_->read.load(std::memory_order_acquire) > capacity_) {
+      layout_->dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!layout_->reserve.compare_exchange_weak(pos, pos + size, std::memory_order_acq_rel,
+                                                   std::memory_order_relaxed));
+  // 先公开长度, 写入方在拷贝期间崩溃时读取方仍可跳过该记录
+  auto word = Word(pos);
+  word.store(Pack(pos, str.size(), k_busy), std::memory_order_relaxed);
+  CopyIn(pos + 8, str);
+  word.store(Pack(pos, str.size(), level), std::memory_order_release);
+  return true;
+}
+
+size_t Ring::Read(const Visitor& func, size_t max) {
+  if (!layout_) return 0;
+  auto read = layout_->read.load(std::memory_order_relaxed);
+  auto reserve = layout_->reserve.load(std::memory_order_acquire);
+  size_t count = 0;
+  while (read < reserve && count < max) {
+    auto word = Word(read).load(std::memory_order_acquire);
+    auto tagged = Tagged(word, read);
+    if (!tagged || Level(word) == k_busy) {
+      // 写入中, 超时后视为写入方已崩溃
+      auto now = std::chrono::steady_clock::now();
+      if (stall_pos_ != read) {
+        stall_pos_ = read;
+        stall_since_ = now;
+        break;
+      }
+      if (now - stall_since_ < k_stall) break;
+      read = tagged ? read + Align(8 + Length(word)) : reserve;
+      layout_->read.store(read, std::memory_order_release);
+      continue;
+    }
+    auto length = Length(word);
+    func(static_cast<level::LEVEL>(std::min<uint8_t>(Level(word), level::FATAL)), View(read + 8, length));
+    read += Align(8 + length);
+    // 回调返回后才释放空间, 内容在回调期间不会被覆盖
+    layout_->read.store(read, std::memory_order_release);
+    ++count;
+  }
+  return count;
+}
+
+uint64_t Ring::dropped() const {
+  return layout_ ? layout_->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t Ring::pending() const {
+  if (!layout_) return 0;
+  return layout_->reserve.load(std::memory_order_acquire) - layout_->read.load(std::memory_order_acquire);
+}
+
+} // shm
+} // log
+} // tools
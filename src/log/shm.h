@@ -0,0 +1,136 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 19:05:44
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 19:05:44
+ * @Description: 共享内存日志环, 生产进程无锁写入, 读取进程(log_tail)在进程外取出并落盘
+ */
+
+#ifndef TOOLS_LOG_SHM_H_
+#define TOOLS_LOG_SHM_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include "log.h"
+
+namespace tools {
+namespace log {
+namespace shm {
+
+// 共享内存结构
+// +------------------------------------------------------------+
+// | magic | version | capacity | reserve | read | dropped       |  头部, 各计数器独占缓存行
+// +------------------------------------------------------------+
+// | word (8 bytes) | payload | padding to 8 | word | ...         |  数据区, 容量为 2 的幂
+// +------------------------------------------------------------+
+//
+// word : | tag (32) = 位置 / 8 | length (24) | level (8) |
+// 写入方以 CAS 推进 reserve 预留空间, 先写入 level 为 k_busy 的 word 公开长度, 拷贝内容后再写入实际等级
+// tag 与当前位置不符时为上一圈的旧数据, 即尚未写入
+// reserve 与 read 均为单调递增的字节位置, 两者之差不超过容量, 满时丢弃新记录
+
+constexpr uint32_t k_magic = 0x474F4C54;    // "TLOG"
+constexpr uint32_t k_version = 1;
+
+/**
+ * 写入方已预留但尚未写完的记录
+ */
+constexpr uint8_t k_busy = 0xFF;
+
+/**
+ * 单条记录的最大长度
+ */
+constexpr size_t k_max_length = (1 << 24) - 1;
+
+/**
+ * 共享内存中的日志环, 同一段可被多个进程的多个线程同时写入, 仅允许一个读取方
+ * 段在所有进程退出后仍然存在, 生产进程崩溃后读取方可继续取出已写入的记录
+ */
+class Ring {
+ public:
+  using Visitor = std::function<void(level::LEVEL, std::string_view)>;
+ public:
+  Ring() = default;
+  ~Ring();
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+  /**
+   * 打开共享内存段, 不存在时按 capacity 创建, 已存在时沿用其容量
+   * @param name 段名称, 如 "/app.log"
+   * @param capacity 数据区容量, 向上取整为 2 的幂, 为 0 时不创建
+   * @return 是否成功, 非 unix 平台始终失败
+   */
+  bool Open(const std::string& name, size_t capacity);
+  void Close();
+  /**
+   * 写入一条记录, 仅拷贝一次, 不加锁
+   * @param level 等级
+   * @param str 内容
+   * @return 空间不足或超出单条上限时丢弃并返回 false
+   */
+  bool Write(level::LEVEL level, std::string_view str);
+  /**
+   * 取出已写入的记录, 仅读取方调用
+   * 某条记录长时间未写完(写入方崩溃)时跳过, 未写入长度时跳过至当前的预留位置
+   * @param func 以 (等级, 内容) 调用, 内容在回调返回前有效
+   * @param max 最多取出的记录数
+   * @return 取出的记录数
+   */
+  size_t Read(const Visitor& func, size_t max = SIZE_MAX);
+  /**
+   * 写入方累计丢弃的记录数
+   */
+  uint64_t dropped() const;
+  /**
+   * 尚未取出的字节数
+   */
+  uint64_t pending() const;
+  inline size_t capacity() const {
+    return capacity_;
+  }
+  inline bool opened() const {
+    return layout_ != nullptr;
+  }
+  /**
+   * 删除共享内存段, 已映射的进程不受影响
+   */
+  static bool Remove(const std::string& name);
+
+ private:
+  struct Layout;
+  /**
+   * 位置 pos 处的 word
+   */
+  std::atomic_ref<uint64_t> Word(uint64_t pos) const;
+  /**
+   * 从 pos 处拷入/拷出, 到达数据区末尾时回绕
+   */
+  void CopyIn(uint64_t pos, std::string_view str);
+  std::string_view View(uint64_t pos, size_t size);
+
+ private:
+  Layout* layout_ = nullptr;
+  char* data_ = nullptr;
+  size_t capacity_ = 0;
+  size_t mapped_ = 0;
+  /**
+   * 跨越数据区末尾的记录拷贝至此后交予读取回调
+   */
+  std::string scratch_;
+  /**
+   * 读取方等待未写完记录的位置及起始时间
+   */
+  uint64_t stall_pos_ = UINT64_MAX;
+  std::chrono::steady_clock::time_point stall_since_;
+};
+
+} // shm
+} // log
+} // tools
+
+#endif //TOOLS_LOG_SHM_H_
@@ -0,0 +1,438 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 10:12:40
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 14:05:12
+ * @Description:
+ */
+
+#include "worker.h"
+
+#include <thread>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#include "logger.h"
+
+namespace tools {
+namespace log {
+namespace {
+
+/**
+ * 写线程每轮从单个队列取出的最大消息数, 保证各线程间的公平性
+ */
+constexpr size_t k_quota = 256;
+
+/**
+ * 队列单元按块分配的单元数, 块在首次写入时才分配, 内存占用随线程实际的积压深度增长
+ */
+constexpr size_t k_chunk = 64;
+
+/**
+ * 写线程无消息时的最长休眠时间, 用于回收已退出线程的队列
+ */
+constexpr auto k_idle = std::chrono::milliseconds(100);
+
+/**
+ * 崩溃时等待写线程停止的最长时间
+ */
+constexpr auto k_halt_wait = std::chrono::milliseconds(100);
+
+std::atomic<uint64_t> g_worker_id{0};
+
+} // namespace
+
+/**
+ * 基于单元序号的有界队列(Vyukov), 容量为 2 的幂
+ * 仅所属线程入队; 写线程出队, 所属线程在 DROP_OLDEST 策略下也会出队, 故出队使用 CAS
+ * 单元按块分配: 入队方第一次到达某块时分配并初始化序号, 之后循环复用, 不再分配
+ */
+class Worker::Ring {
+ public:
+  explicit Ring(size_t capacity) {
+    size_t size = k_chunk;
+    while (size < capacity) size <<= 1;
+    chunks_ = std::make_unique<std::atomic<Cell*>[]>(size / k_chunk);
+    mask_ = size - 1;
+  }
+  ~Ring() {
+    for (size_t i = 0; i <= mask_ / k_chunk; i++) {
+      delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
+  }
+  /**
+   * 入队, 仅所属线程调用, 成功时才会移走 msg
+   * @return 队列满时返回 false
+   */
+  bool TryPush(Logger* logger, Msg& msg) {
+    auto pos = tail_.load(std::memory_order_relaxed);
+    auto index = (pos & mask_) / k_chunk;
+    auto chunk = chunks_[index].load(std::memory_order_relaxed);
+    if (!chunk) {
+      // 仅首轮到达时分配, 单元序号即其在首轮中的位置
+      chunk = new Cell[k_chunk];
+      for (size_t i = 0; i < k_chunk; i++) {
+        chunk[i].seq.store(index * k_chunk + i, std::memory_order_relaxed);
+      }
+      chunks_[index].store(chunk, std::memory_order_release);
+    }
+    auto& cell = chunk[pos % k_chunk];
+    if (cell.seq.load(std::memory_order_acquire) != pos) return false;
+    cell.item.logger = logger;
+    cell.item.msg = std::move(msg);
+    cell.seq.store(pos + 1, std::memory_order_release);
+    tail_.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+  /**
+   * 出队
+   * @return 队列空时返回 false
+   */
+  bool TryPop(Item& item) {
+    auto pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      // 块未分配时其中的单元尚未入队过
+      auto cell_ptr = At(pos);
+      if (!cell_ptr) return false;
+      auto& cell = *cell_ptr;
+      auto diff = static_cast<int64_t>(cell.seq.load(std::memory_order_acquire) - (pos + 1));
+      if (diff < 0) return false;
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          item = std::move(cell.item);
+          cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+  /**
+   * 队首消息的时间戳, 不出队, 仅写线程调用
+   * @param time 时间戳
+   * @return 队列空时返回 false
+   */
+  bool Front(uint64_t& time) const {
+    auto pos = head_.load(std::memory_order_relaxed);
+    auto cell = At(pos);
+    if (!cell || cell->seq.load(std::memory_order_acquire) != pos + 1) return false;
+    time = cell->item.msg.time;
+    return true;
+  }
+  /**
+   * 不出队遍历已入队的消息, 仅用于崩溃时排空
+   */
+  template <typename Func>
+  void Visit(Func&& func) {
+    auto tail = tail_.load(std::memory_order_acquire);
+    for (auto pos = head_.load(std::memory_order_acquire); pos != tail; ++pos) {
+      auto cell = At(pos);
+      if (cell && cell->seq.load(std::memory_order_acquire) == pos + 1) func(cell->item);
+    }
+  }
+  inline bool Empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+  /**
+   * 已入队消息数
+   */
+  inline uint64_t pushed() const {
+    return tail_.load(std::memory_order_acquire);
+  }
+
+ public:
+  /**
+   * 已处理(含丢弃)消息数, 用于 Flush 判断
+   */
+  alignas(64) std::atomic<uint64_t> done{0};
+  /**
+   * 所属线程正在入队, 写线程停止时需等待其结束
+   */
+  std::atomic<bool> busy{false};
+  /**
+   * 所属线程已退出, 队列清空后回收
+   */
+  std::atomic<bool> closed{false};
+
+ private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    Item item;
+  };
+  /**
+   * 位置 pos 处的单元, 所在块未分配时返回空
+   */
+  inline Cell* At(size_t pos) const {
+    auto chunk = chunks_[(pos & mask_) / k_chunk].load(std::memory_order_acquire);
+    return chunk ? chunk + pos % k_chunk : nullptr;
+  }
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  std::unique_ptr<std::atomic<Cell*>[]> chunks_;
+  size_t mask_;
+};
+
+namespace {
+
+/**
+ * 线程持有的队列, 线程退出时将其转交写线程
+ */
+struct LocalRing {
+  uint64_t worker = 0;
+  std::shared_ptr<Worker::Ring> ring;
+  ~LocalRing() {
+    if (ring) ring->closed.store(true, std::memory_order_release);
+  }
+};
+
+} // namespace
+
+Worker::Worker(const AsyncConfig& cfg)
+    : cfg_(cfg),
+      id_(++g_worker_id) {
+  thread_ = std::make_unique<async::Thread>("log.worker", &Worker::Run, this);
+  crash::Register(this, crash::QUEUE);
+}
+
+Worker::~Worker() {
+  crash::Unregister(this, crash::QUEUE);
+  Stop();
+}
+
+Worker::Ring* Worker::Acquire() {
+  static thread_local LocalRing local;
+  if (local.worker == id_) return local.ring.get();
+  auto ring = std::make_shared<Ring>(cfg_.capacity ? cfg_.capacity : 1);
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (stop_.load(std::memory_order_relaxed)) return nullptr;
+    rings_.push_back(ring);
+    changed_.store(true, std::memory_order_release);
+  }
+  // 之前注册在其他写线程中的队列交由其输出后回收
+  if (local.ring) local.ring->closed.store(true, std::memory_order_release);
+  local.worker = id_;
+  local.ring = std::move(ring);
+  return local.ring.get();
+}
+
+bool Worker::Push(Logger* logger, Msg& msg) {
+  auto ring = Acquire();
+  if (!ring) return false;
+  // 先标记入队中再检查停止标记, 与 Run 中的先置停止标记再等待 busy 对应
+  ring->busy.store(true, std::memory_order_seq_cst);
+  if (stop_.load(std::memory_order_seq_cst)) {
+    ring->busy.store(false, std::memory_order_release);
+    return false;
+  }
+  if (!ring->TryPush(logger, msg)) {
+    switch (cfg_.policy) {
+      case overflow::DROP_NEWEST:
+        // 直接丢弃当前消息
+        ring->busy.store(false, std::memory_order_release);
+        logger->metrics().Local().dropped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      case overflow::DROP_OLDEST: {
+        // 丢弃队首消息腾出空位, 计入已处理数; 写线程同时出队时空位同样可用
+        Item oldest;
+        do {
+          if (ring->TryPop(oldest)) {
+            ring->done.fetch_add(1, std::memory_order_seq_cst);
+            oldest.logger->metrics().Local().dropped.fetch_add(1, std::memory_order_relaxed);
+          }
+        } while (!ring->TryPush(logger, msg));
+        break;
+      }
+      default:
+        do {
+          if (stop_.load(std::memory_order_seq_cst)) {
+            ring->busy.store(false, std::memory_order_release);
+            return false;
+          }
+          Notify();
+          std::this_thread::yield();
+        } while (!ring->TryPush(logger, msg));
+        break;
+    }
+  }
+  ring->busy.store(false, std::memory_order_release);
+  Notify();
+  return true;
+}
+
+void Worker::Notify() {
+  // 与 Run 中置 sleeping_ 后再检查队列对应, 两者至少有一方能看到对方的修改
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    not_empty_.notify_one();
+  }
+}
+
+void Worker::Flush() {
+  std::vector<std::pair<std::shared_ptr<Ring>, uint64_t> > targets;
+  std::unique_lock<std::mutex> lk(mutex_);
+  targets.reserve(rings_.size());
+  for (auto& i : rings_) {
+    targets.emplace_back(i, i->pushed());
+  }
+  waiters_.fetch_add(1, std::memory_order_seq_cst);
+  not_empty_.notify_one();
+  drained_.wait(lk, [&]{
+    return std::all_of(targets.begin(), targets.end(), [](auto& i){
+      return i.first->done.load(std::memory_order_seq_cst) >= i.second;
+    });
+  });
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+uint64_t Worker::Depth() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  uint64_t depth = 0;
+  for (auto& i : rings_) {
+    auto pushed = i->pushed();
+    auto done = i->done.load(std::memory_order_relaxed);
+    if (pushed > done) depth += pushed - done;
+  }
+  return depth;
+}
+
+void Worker::Stop() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (stop_.load(std::memory_order_relaxed)) return;
+    stop_.store(true, std::memory_order_seq_cst);
+  }
+  not_empty_.notify_all();
+  thread_->Join();
+}
+
+void Worker::Run() {
+  // 写线程同样可能栈溢出, 需在自身的备用信号栈上排空
+  crash::InstallThreadStack();
+  std::vector<std::shared_ptr<Ring> > rings;
+  std::vector<size_t> counts;
+  std::vector<Item> batch;
+  std::vector<Msg> msgs;
+  batch.reserve(k_quota);
+  for (;;) {
+    if (halt_.load(std::memory_order_acquire)) {
+      // 进程即将退出, 剩余消息交由崩溃处理排空, 不再返回
+      halted_.store(true, std::memory_order_release);
+      for (;;) std::this_thread::sleep_for(k_idle);
+    }
+    auto stopping = stop_.load(std::memory_order_seq_cst);
+    if (changed_.exchange(false, std::memory_order_acq_rel) || stopping) {
+      std::lock_guard<std::mutex> lk(mutex_);
+      rings = rings_;
+    }
+    if (stopping) {
+      // 停止后不再有新消息入队, 等待进行中的入队结束后输出剩余消息
+      for (auto& i : rings) {
+        while (i->busy.load(std::memory_order_seq_cst)) std::this_thread::yield();
+      }
+    }
+    counts.assign(rings.size(), 0);
+    if (cfg_.ordered) {
+      Merge(rings, counts, batch);
+    } else {
+      // 轮询各队列, 每个队列至多取出 k_quota 条
+      for (size_t i = 0; i < rings.size(); i++) {
+        Item item;
+        while (counts[i] < k_quota && rings[i]->TryPop(item)) {
+          batch.push_back(std::move(item));
+          ++counts[i];
+        }
+      }
+    }
+    if (batch.empty()) {
+      if (stopping) break;
+      // 回收已退出线程的空队列
+      auto closed = [](const std::shared_ptr<Ring>& ring) {
+        return ring->closed.load(std::memory_order_acquire) && ring->Empty();
+      };
+      if (std::any_of(rings.begin(), rings.end(), closed)) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        rings_.erase(std::remove_if(rings_.begin(), rings_.end(), closed), rings_.end());
+        changed_.store(true, std::memory_order_relaxed);
+      }
+      std::unique_lock<std::mutex> lk(mutex_);
+      sleeping_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto empty = std::all_of(rings.begin(), rings.end(), [](auto& i){ return i->Empty(); });
+      if (empty && !changed_.load(std::memory_order_relaxed) && !stop_.load(std::memory_order_relaxed)) {
+        not_empty_.wait_for(lk, k_idle);
+      }
+      sleeping_.store(false, std::memory_order_relaxed);
+      continue;
+    }
+    // 相邻的同一日志器消息合并为一批输出, 输出端每批仅写出一次
+    for (size_t i = 0; i < batch.size();) {
+      auto& logger = batch[i].logger;
+      msgs.clear();
+      for (; i < batch.size() && batch[i].logger == logger; i++) {
+        msgs.push_back(std::move(batch[i].msg));
+      }
+      (*logger)(msgs.data(), msgs.size());
+    }
+    msgs.clear();
+    batch.clear();
+    for (size_t i = 0; i < rings.size(); i++) {
+      if (counts[i]) rings[i]->done.fetch_add(counts[i], std::memory_order_seq_cst);
+    }
+    if (waiters_.load(std::memory_order_seq_cst)) {
+      std::lock_guard<std::mutex> lk(mutex_);
+      drained_.notify_all();
+    }
+  }
+}
+
+void Worker::Merge(const std::vector<std::shared_ptr<Ring> >& rings, std::vector<size_t>& counts,
+                   std::vector<Item>& batch) {
+  // 各线程队列内有序, 每次取出队首时间戳最早的一条, 队首未取出前不会输出其他队列中更晚的消息
+  using Head = std::pair<uint64_t, size_t>;
+  std::vector<Head> heads;
+  uint64_t time;
+  for (size_t i = 0; i < rings.size(); i++) {
+    if (rings[i]->Front(time)) heads.emplace_back(time, i);
+  }
+  auto later = std::greater<Head>();
+  std::make_heap(heads.begin(), heads.end(), later);
+  auto limit = k_quota * rings.size();
+  Item item;
+  while (!heads.empty() && batch.size() < limit) {
+    std::pop_heap(heads.begin(), heads.end(), later);
+    auto i = heads.back().second;
+    heads.pop_back();
+    if (!rings[i]->TryPop(item)) continue;
+    batch.push_back(std::move(item));
+    ++counts[i];
+    if (rings[i]->Front(time)) {
+      heads.emplace_back(time, i);
+      std::push_heap(heads.begin(), heads.end(), later);
+    }
+  }
+}
+
+void Worker::Halt() {
+  halt_.store(true, std::memory_order_seq_cst);
+  // 休眠中的写线程不会输出, 醒来后先检查 halt_
+  for (auto waited = std::chrono::milliseconds(0); waited < k_halt_wait; waited += std::chrono::milliseconds(1)) {
+    if (halted_.load(std::memory_order_acquire) || sleeping_.load(std::memory_order_seq_cst)) return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void Worker::Drain() {
+  for (auto& ring : rings_) {
+    if (!ring) continue;
+    ring->Visit([](Item& item) {
+      if (item.logger) item.logger->Emergency(item.msg.level, crash::FormatLine(item.msg));
+    });
+  }
+}
+
+} // log
+} // tools
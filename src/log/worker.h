@@ -0,0 +1,142 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 10:12:40
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 14:05:12
+ * @Description:
+ */
+
+#ifndef TOOLS_LOG_WORKER_H_
+#define TOOLS_LOG_WORKER_H_
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+
+#include <async.h>
+
+#include "log.h"
+#include "logger.h"
+#include "crash.h"
+
+namespace tools {
+namespace log {
+
+/**
+ * 异步写线程, 生产者仅入队, 格式化与输出均在后台线程完成
+ * 每个生产线程首次入队时注册一个独占的有界队列, 入队无需加锁, 写线程轮询各队列输出
+ * 崩溃时作为 crash::QUEUE 阶段排空, 队列中的消息直接写至各日志器的输出端
+ */
+class Worker : public crash::Drainable {
+ public:
+  /**
+   * 队列元素, 入队时即确定日志器, 避免后台线程再次查找
+   * 日志器以裸指针保存(由管理器持有), 入队不修改共享的引用计数
+   * 消息按值存放于队列单元中, 单元块首次使用后循环复用, 稳定后入队不分配内存
+   */
+  struct Item {
+    Logger* logger = nullptr;
+    Msg msg;
+  };
+  /**
+   * 生产线程独占的有界队列
+   */
+  class Ring;
+ public:
+  explicit Worker(const AsyncConfig& cfg);
+  /**
+   * 析构时输出剩余消息并等待线程退出
+   */
+  ~Worker() override;
+  /**
+   * 消息入队, 队列满时按配置策略阻塞或丢弃
+   * @param logger 日志器, 由管理器持有直至其析构
+   * @param msg 日志消息, 入队成功时被移走
+   * @return 写线程已停止时返回 false, 交由调用者同步输出
+   */
+  bool Push(Logger* logger, Msg& msg);
+  /**
+   * 等待当前已入队的消息全部输出完毕
+   */
+  void Flush();
+  /**
+   * 停止写线程, 返回前输出剩余消息
+   */
+  void Stop();
+  /**
+   * 所有队列中待输出的消息数
+   */
+  uint64_t Depth();
+  /**
+   * 崩溃时令写线程在输出完当前一批后停止, 至多等待 100 毫秒
+   * 崩溃发生在写线程自身时等待超时, 其正在输出的一批消息可能丢失
+   */
+  void Halt() override;
+  /**
+   * 崩溃时不加锁遍历各队列, 将尚未出队的消息逐条写出
+   */
+  void Drain() override;
+
+ private:
+  /**
+   * 获取当前线程的队列, 首次调用时创建并注册
+   * 线程退出时队列标记为关闭, 剩余消息仍由写线程输出
+   * @return 写线程已停止时返回空
+   */
+  Ring* Acquire();
+  /**
+   * 写线程休眠时将其唤醒
+   */
+  void Notify();
+  /**
+   * 写线程主循环
+   */
+  void Run();
+  /**
+   * 按各队列的队首时间戳归并取出一批消息, 用于 AsyncConfig::ordered
+   * @param rings 队列
+   * @param counts 各队列取出的条数
+   * @param batch 取出的消息, 按时间戳排序
+   */
+  void Merge(const std::vector<std::shared_ptr<Ring> >& rings, std::vector<size_t>& counts, std::vector<Item>& batch);
+
+ private:
+  AsyncConfig cfg_;
+  /**
+   * 实例序号, 用于区分线程缓存的队列所属的写线程
+   */
+  const uint64_t id_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable drained_;
+  /**
+   * 已注册的队列, 仅在持有 mutex_ 时修改
+   */
+  std::vector<std::shared_ptr<Ring> > rings_;
+  /**
+   * rings_ 是否已修改, 写线程据此刷新本地副本
+   */
+  std::atomic<bool> changed_{false};
+  /**
+   * 写线程是否即将休眠, 生产者仅在此时加锁唤醒
+   */
+  std::atomic<bool> sleeping_{false};
+  /**
+   * 等待 Flush 的线程数
+   */
+  std::atomic<uint32_t> waiters_{0};
+  std::atomic<bool> stop_{false};
+  /**
+   * 崩溃时置位, 写线程在下一轮开始前停止并置位 halted_
+   */
+  std::atomic<bool> halt_{false};
+  std::atomic<bool> halted_{false};
+  std::unique_ptr<async::Thread> thread_;
+};
+
+} // log
+} // tools
+
+#endif //TOOLS_LOG_WORKER_H_
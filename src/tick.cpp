@@ -0,0 +1,248 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 20:12:37
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 20:12:37
+ * @Description:
+ */
+
+#include "tick.h"
+
+#include <algorithm>
+
+#if TOOLS_TICK_TSC && !_WIN32
+#include <cpuid.h>
+#endif
+
+namespace tools {
+namespace tick {
+namespace detail {
+
+std::atomic<uint8_t> g_source{source::UNKNOWN};
+
+} // detail
+
+namespace {
+
+/**
+ * 重新校准的间隔
+ */
+constexpr int64_t k_interval = 1000000000;
+
+/**
+ * 基准采样经过的时间短于该值时测得的频率误差较大, 此时的校准结果为暂定值, 经过该时间后即重新校准
+ */
+constexpr int64_t k_min_span = 1000000;
+
+/**
+ * 读取校准结果时的最大重试次数, 信号处理函数打断了本线程的校准时不会无限等待
+ */
+constexpr int k_max_retry = 64;
+
+/**
+ * 重新校准时与墙上时间的偏差在该值以内则平滑修正, 超出视为墙上时间被调整, 直接跳变
+ */
+constexpr int64_t k_max_slew_offset = 128000000;
+
+/**
+ * 平滑修正的最大速率(500ppm), 同 adjtime
+ */
+constexpr double k_max_slew_rate = 0.0005;
+
+/**
+ * 一次采样: 计数及同一时刻的单调时钟/墙上时间
+ */
+struct Sample {
+  uint64_t ticks;
+  int64_t steady;
+  int64_t wall;
+};
+
+/**
+ * 校准结果, 以序列锁保护, 写入方为持有 g_busy 的线程
+ * 换算公式: 墙上时间 = wall + (计数 - ticks) * scale
+ * 重新校准时 wall 取上次结果在 ticks 处的换算值, 使换算结果连续,
+ * 与墙上时间的偏差计入 scale 在下一个校准周期内平滑消除
+ */
+std::atomic<uint32_t> g_seq{0};
+std::atomic<uint64_t> g_ticks{0};
+std::atomic<int64_t> g_wall{0};
+std::atomic<double> g_scale{0};
+/**
+ * 测得的每计数纳秒数, 不含平滑修正
+ */
+std::atomic<double> g_period{0};
+/**
+ * 计数超过该值时需重新校准
+ */
+std::atomic<uint64_t> g_next{0};
+std::atomic<bool> g_busy{false};
+
+/**
+ * 启动时的基准采样, 频率以此为起点测量, 间隔越长越精确
+ */
+Sample g_base;
+
+inline uint64_t Raw(source::TYPE type) {
+#if TOOLS_TICK_TSC
+  if (type == source::TSC) return __rdtsc();
+#endif
+  (void)type;
+  return detail::Steady();
+}
+
+inline int64_t Wall() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * CPUID 0x80000007 EDX bit 8: invariant TSC
+ */
+bool Invariant() {
+#if TOOLS_TICK_TSC
+#if _WIN32
+  int info[4];
+  __cpuid(info, 0x80000000);
+  if (static_cast<unsigned>(info[0]) < 0x80000007) return false;
+  __cpuid(info, 0x80000007);
+  return info[3] & (1 << 8);
+#else
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+  return edx & (1u << 8);
+#endif
+#else
+  return false;
+#endif
+}
+
+/**
+ * 取多次采样中两次读取计数间隔最短的一次, 减少中断/调度带来的误差
+ */
+Sample Take(source::TYPE type) {
+  Sample best{};
+  uint64_t best_gap = UINT64_MAX;
+  for (int i = 0; i < 4; i++) {
+    auto begin = Raw(type);
+    auto steady = static_cast<int64_t>(detail::Steady());
+    auto wall = Wall();
+    auto end = Raw(type);
+    if (end - begin < best_gap) {
+      best_gap = end - begin;
+      best = {begin + (end - begin) / 2, steady, wall};
+    }
+  }
+  return best;
+}
+
+source::TYPE Setup() {
+  auto type = Invariant() ? source::TSC : source::STEADY;
+  g_base = Take(type);
+  detail::g_source.store(type, std::memory_order_release);
+  return type;
+}
+
+/**
+ * 以基准采样至当前的间隔测量每计数纳秒数, 频率对照单调时钟测量, 不受墙上时间跳变影响
+ */
+double Measure(source::TYPE type, const Sample& sample) {
+  if (type != source::TSC || sample.ticks <= g_base.ticks) return 1;
+  return static_cast<double>(sample.steady - g_base.steady) / static_cast<double>(sample.ticks - g_base.ticks);
+}
+
+/**
+ * 重新校准, 同一时刻仅一个线程执行, 其余线程沿用上次的结果
+ * 不等待基准采样经过 k_min_span, 首次换算不在日志路径上忙等, 此前的结果为暂定值, 到期后再次校准
+ */
+void Calibrate(source::TYPE type) {
+  if (g_busy.exchange(true, std::memory_order_acquire)) return;
+  auto sample = Take(type);
+  while (type == source::TSC && sample.steady <= g_base.steady) sample = Take(type);
+  auto span = sample.steady - g_base.steady;
+  auto period = Measure(type, sample);
+  auto wall = sample.wall;
+  auto scale = period;
+  // 仅持有 g_busy 的线程写入, 可直接读取上次的结果
+  auto last_scale = g_scale.load(std::memory_order_relaxed);
+  if (last_scale != 0) {
+    auto last_ticks = g_ticks.load(std::memory_order_relaxed);
+    auto expect = g_wall.load(std::memory_order_relaxed) +
+                  static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(sample.ticks - last_ticks)) * last_scale);
+    auto offset = sample.wall - expect;
+    if (offset >= -k_max_slew_offset && offset <= k_max_slew_offset) {
+      // 锚点沿用换算值, 偏差按不超过 k_max_slew_rate 的速率在下一周期内追平, 换算结果保持单调
+      auto rate = std::clamp(static_cast<double>(offset) / static_cast<double>(k_interval),
+                             -k_max_slew_rate, k_max_slew_rate);
+      wall = expect;
+      scale = period * (1 + rate);
+    }
+  }
+  auto seq = g_seq.load(std::memory_order_relaxed);
+  g_seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  g_ticks.store(sample.ticks, std::memory_order_relaxed);
+  g_wall.store(wall, std::memory_order_relaxed);
+  g_scale.store(scale, std::memory_order_relaxed);
+  g_seq.store(seq + 2, std::memory_order_release);
+  g_period.store(period, std::memory_order_relaxed);
+  auto interval = span < k_min_span ? k_min_span - span : k_interval;
+  g_next.store(sample.ticks + static_cast<uint64_t>(static_cast<double>(interval) / period), std::memory_order_relaxed);
+  g_busy.store(false, std::memory_order_release);
+}
+
+/**
+ * 首次校准尚未完成(由其他线程或被信号打断的本线程执行)时的换算,
+ * 以基准采样至当前的间隔估算频率, 结果不发布
+ */
+int64_t Provisional(source::TYPE type, uint64_t ticks) {
+  auto sample = Take(type);
+  while (type == source::TSC && sample.steady <= g_base.steady) sample = Take(type);
+  auto delta = static_cast<int64_t>(ticks - sample.ticks);
+  return sample.wall + static_cast<int64_t>(static_cast<double>(delta) * Measure(type, sample));
+}
+
+} // namespace
+
+namespace detail {
+
+source::TYPE Init() {
+  static const auto type = Setup();
+  return type;
+}
+
+} // detail
+
+int64_t ToNanos(uint64_t ticks) {
+  auto type = Source();
+  if (ticks >= g_next.load(std::memory_order_relaxed)) Calibrate(type);
+  for (int i = 0; i < k_max_retry; i++) {
+    auto seq = g_seq.load(std::memory_order_acquire);
+    if (seq & 1) continue;
+    auto base = g_ticks.load(std::memory_order_relaxed);
+    auto wall = g_wall.load(std::memory_order_relaxed);
+    auto scale = g_scale.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (g_seq.load(std::memory_order_relaxed) != seq) continue;
+    // 其他线程正在进行首次校准
+    if (scale == 0) return Provisional(type, ticks);
+    // 计数可能早于校准点(队列中较早的消息), 按有符号差值换算
+    auto delta = static_cast<int64_t>(ticks - base);
+    return wall + static_cast<int64_t>(static_cast<double>(delta) * scale);
+  }
+  return Provisional(type, ticks);
+}
+
+source::TYPE Source() {
+  auto type = static_cast<source::TYPE>(detail::g_source.load(std::memory_order_acquire));
+  return type == source::UNKNOWN ? detail::Init() : type;
+}
+
+double Frequency() {
+  ToNanos(Now());
+  auto period = g_period.load(std::memory_order_relaxed);
+  return period > 0 ? 1e9 / period : 0;
+}
+
+} // tick
+} // tools
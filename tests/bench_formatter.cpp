@@ -0,0 +1,104 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 11:02:15
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 11:02:15
+ * @Description: 格式器微基准, 对比逐项返回字符串的旧路径与追加至复用缓存的新路径
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+
+#include "logger.h"
+
+/*
+ * 循环次数
+ */
+int g_loop_count          = 1000000;
+/*
+ * 测试格式
+ */
+const char* g_pattern     = "%d <%p> [%f:%l] [%c] %m";
+
+/*
+ * 堆分配计数
+ */
+std::atomic<uint64_t> g_alloc_count{0};
+
+void* operator new(size_t size) {
+  g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+  if (auto ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+using namespace tools::log;
+
+/**
+ * 旧路径: 每项返回一个新字符串, 经 ostringstream 拼接后为两个输出端各拷贝一次
+ */
+size_t legacy_format(const Formatter& formatter, const Msg& msg) {
+  std::ostringstream oss;
+  for (auto& i : formatter.pattern()) {
+    std::string item;
+    (*i)(msg, item);
+    oss << item;
+  }
+  auto console = oss.str();
+  auto file = oss.str();
+  return console.size() + file.size();
+}
+
+/**
+ * 新路径: 直接追加至复用缓存
+ */
+size_t compiled_format(const Formatter& formatter, const Msg& msg) {
+  static thread_local std::string buffer;
+  buffer.clear();
+  formatter.Format(msg, buffer);
+  return buffer.size() * 2;
+}
+
+template <typename Func>
+void bench(const char* name, Func&& func, const Formatter& formatter, const Msg& msg) {
+  size_t bytes = 0;
+  // 预热, 使复用缓存容量稳定
+  bytes += func(formatter, msg);
+  auto allocs = g_alloc_count.load();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < g_loop_count; i++) {
+    bytes += func(formatter, msg);
+  }
+  auto end = std::chrono::steady_clock::now();
+  allocs = g_alloc_count.load() - allocs;
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  printf("%-10s %8.1f ns/line %8.2f allocs/line (%zu bytes)\n",
+         name, static_cast<double>(ns) / g_loop_count,
+         static_cast<double>(allocs) / g_loop_count, bytes);
+}
+
+// [loop_count] [pattern]
+int main(int argc, char* argv[]) {
+  if (argc > 1) g_loop_count = atoi(argv[1]);
+  if (argc > 2) g_pattern = argv[2];
+
+  Formatter formatter;
+  formatter.Parse(g_pattern);
+  static constexpr CallSite site{nullptr, __FILE__, BaseName(__FILE__), __FUNCTION__, __LINE__, level::INFO};
+  Msg msg{tools::tick::Now(), &site, level::INFO, "request handled, id=42 latency_us=1375\n"};
+
+  bench("legacy", legacy_format, formatter, msg);
+  bench("compiled", compiled_format, formatter, msg);
+  return 0;
+}
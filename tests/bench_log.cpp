@@ -0,0 +1,158 @@
+/*
+ * @Author: zyxeeker zyxeeker@gmail.com
+ * @Date: 2026-10-18 17:05:48
+ * @LastEditors: zyxeeker zyxeeker@gmail.com
+ * @LastEditTime: 2026-10-18 17:05:48
+ * @Description: 日志路径基准, 覆盖各输出端/同步与异步/不同生产线程数, 结果以 JSON Lines 输出至标准错误
+ *               控制台输出端会写入标准输出, 建议以 bench_log > /dev/null 2> result.jsonl 运行
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <log.h>
+
+/*
+ * 每个线程的循环次数
+ */
+int g_loop_count          = 100000;
+/*
+ * 最大生产线程数, 从 1 开始倍增
+ */
+int g_max_threads         = 0;
+/*
+ * 测试的输出端, 逗号分隔
+ */
+const char* g_sinks       = "null,file,mmap,console";
+/*
+ * 输出格式
+ */
+const char* g_pattern     = "%d [%p] (%f:%l) %m";
+
+using namespace tools::log;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * 按输出端生成配置, null 为写入 /dev/null 的文件, 仍包含完整的格式化与写入过程
+ */
+Config MakeConfig(const std::string& sink) {
+  Config cfg;
+  cfg.name = "bench";
+  cfg.pattern = g_pattern;
+  cfg.toConsole = false;
+  cfg.toFile = false;
+  // 按字节组提交, 避免逐行 fsync 掩盖日志路径本身的开销
+  cfg.flushPolicy = flush::BYTES;
+  if (sink == "console") {
+    cfg.toConsole = true;
+  } else if (sink == "null") {
+    cfg.toFile = true;
+#if _WIN32
+    cfg.fileName = "NUL";
+#else
+    cfg.fileName = "/dev/null";
+#endif
+  } else {
+    cfg.toFile = true;
+    cfg.fileName = "bench_log." + sink + ".log";
+    cfg.mmap = sink == "mmap";
+  }
+  return cfg;
+}
+
+/**
+ * 单个生产线程, 记录每次调用的耗时
+ */
+void Produce(int count, std::vector<uint32_t>& latencies) {
+  latencies.resize(count);
+  for (int i = 0; i < count; i++) {
+    auto start = Clock::now();
+    CLOG("bench") << "bench message #" << i << " value=" << 3.14159 << " tag=" << "abcdef" << '\n';
+    latencies[i] = static_cast<uint32_t>(std::min<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count(), UINT32_MAX));
+  }
+}
+
+uint32_t Percentile(const std::vector<uint32_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  auto index = static_cast<size_t>(p / 100 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void Bench(const std::string& sink, bool async, int threads) {
+  RegisterLogger(MakeConfig(sink));
+  if (async) EnableAsync({4096, overflow::BLOCK});
+  // 预热, 创建线程队列及复用缓存
+  std::vector<uint32_t> warmup;
+  Produce(std::min(g_loop_count, 1000), warmup);
+  Flush();
+
+  std::vector<std::vector<uint32_t> > latencies(threads);
+  std::vector<std::thread> producers;
+  auto start = Clock::now();
+  for (int t = 0; t < threads; t++) {
+    producers.emplace_back(Produce, g_loop_count, std::ref(latencies[t]));
+  }
+  for (auto& i : producers) {
+    i.join();
+  }
+  auto produced = Clock::now();
+  // 吞吐量包含异步队列排空及落盘的时间
+  Flush();
+  auto end = Clock::now();
+
+  if (async) DisableAsync();
+  UnregisterLogger("bench");
+
+  std::vector<uint32_t> all;
+  all.reserve(static_cast<size_t>(g_loop_count) * threads);
+  for (auto& i : latencies) {
+    all.insert(all.end(), i.begin(), i.end());
+  }
+  std::sort(all.begin(), all.end());
+  auto messages = static_cast<uint64_t>(g_loop_count) * threads;
+  auto wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  auto produce_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(produced - start).count();
+  fprintf(stderr,
+          "{\"sink\":\"%s\",\"mode\":\"%s\",\"threads\":%d,\"messages\":%llu,"
+          "\"wall_ms\":%.3f,\"msgs_per_sec\":%.0f,\"produce_msgs_per_sec\":%.0f,"
+          "\"p50_ns\":%u,\"p99_ns\":%u,\"p999_ns\":%u,\"max_ns\":%u}\n",
+          sink.c_str(), async ? "async" : "sync", threads, static_cast<unsigned long long>(messages),
+          wall_ns / 1e6, messages * 1e9 / std::max<int64_t>(wall_ns, 1),
+          messages * 1e9 / std::max<int64_t>(produce_ns, 1),
+          Percentile(all, 50), Percentile(all, 99), Percentile(all, 99.9), all.empty() ? 0 : all.back());
+}
+
+// [loop_count] [max_threads] [sinks] [pattern]
+int main(int argc, char* argv[]) {
+  if (argc > 1) g_loop_count = atoi(argv[1]);
+  if (argc > 2) g_max_threads = atoi(argv[2]);
+  if (argc > 3) g_sinks = argv[3];
+  if (argc > 4) g_pattern = argv[4];
+  if (g_max_threads <= 0) {
+    g_max_threads = static_cast<int>(std::min(8u, std::max(1u, std::thread::hardware_concurrency())));
+  }
+
+  std::vector<std::string> sinks;
+  for (const char* p = g_sinks; *p;) {
+    auto end = std::strchr(p, ',');
+    auto len = end ? static_cast<size_t>(end - p) : std::strlen(p);
+    if (len) sinks.emplace_back(p, len);
+    p += len + (end ? 1 : 0);
+  }
+
+  for (auto& sink : sinks) {
+    for (int async = 0; async < 2; async++) {
+      for (int threads = 1; threads <= g_max_threads; threads *= 2) {
+        Bench(sink, async, threads);
+      }
+    }
+  }
+  return 0;
+}
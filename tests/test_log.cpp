@@ -2,10 +2,32 @@
 // Created by zyxeeker on 2024/3/29.
 //
 
+#include <thread>
+#include <vector>
 #include <iostream>
 #include <log.h>
+#include <cvt.hpp>
+#include <nanomsg/nn.h>
+#include <nanomsg/pipeline.h>
+
+#include "shm.h"
+
+struct Point {
+  int x;
+  double y;
+  std::string tag;
+  VAR_PROPERTY_SCOPE(Point,
+                     VAR_PROPERTY(x),
+                     VAR_PROPERTY(y),
+                     VAR_PROPERTY(tag))
+};
+
+// 文件名在编译期取出
+static_assert(std::string_view(tools::log::BaseName("a/b/test_log.cpp")) == "test_log.cpp");
 
 int main() {
+  // 崩溃时排空缓存及异步队列
+  tools::log::InstallCrashHandler();
   LOG_D() << "HELLO TEST#" << 0 << std::endl;
   LOG("HELLO %s#%d\n", "TEST", 1);
   tools::log::SetLevel(tools::log::level::INFO);
@@ -36,4 +58,207 @@ int main() {
   CLOG_E("test#3") << "test#3 TEST#" << 4 << std::endl;
   CLOG_F("test#3") << "test#3 TEST#" << 5 << std::endl;
 
+  // 按日志器设置等级, 未启用的等级不会对参数求值
+  int evaluated = 0;
+  auto count = [&]{ return ++evaluated; };
+  tools::log::SetLevel("test#2", tools::log::level::ERROR);
+  CLOG_W("test#2") << "filtered by logger level " << count() << std::endl;
+  tools::log::SetLevel(tools::log::level::ERROR);
+  LOG_W() << "filtered before build " << count() << std::endl;
+  tools::log::SetLevel(tools::log::level::INFO);
+  if (evaluated != 0) {
+    std::cerr << "filtered arguments evaluated: " << evaluated << std::endl;
+    return 1;
+  }
+
+  // 编译期校验的格式化输出, 占位符与参数不匹配时无法编译
+  LOG_FMT("fmt TEST#{} {:s}|{:08.3f}|{:04x}|{:6}|{:3}|{:5d}|\n", 6, "str", -3.14159, 255, true, 'c', -42);
+  LOG_FMT_W("fmt {{escaped}} {:x} {:X} {:b} {:.3s} {}\n", 255, 255, 5, "abcdef", nullptr);
+  LOG_FMT("fmt reflect {} range {}\n", Point{1, 2.5, "p"}, std::vector<int>{1, 2, 3});
+  CLOG_FMT_E("test#1", "fmt TEST#{} {}\n", 7, std::string("custom"));
+
+  // 控制台按等级着色, ERROR/FATAL 输出至标准错误
+  tools::log::Config color_cfg{"test#8", "[%p] %m", true, false, ""};
+  color_cfg.consoleColor = true;
+  color_cfg.consoleStderr = true;
+  tools::log::RegisterLogger(color_cfg);
+  CLOG_D("test#8") << "color TEST#" << 1 << std::endl;
+  CLOG("test#8") << "color TEST#" << 2 << std::endl;
+  CLOG_W("test#8") << "color TEST#" << 3 << std::endl;
+  CLOG_E("test#8") << "color TEST#" << 4 << std::endl;
+  CLOG_F("test#8") << "color TEST#" << 5 << std::endl;
+
+  // 组提交落盘
+  tools::log::RegisterLogger({"test#4", "%d [%p] %m", false, true, "test4.log",
+                              tools::log::flush::BYTES, 256});
+  for (int i = 0; i < 10; i++) {
+    CLOG("test#4") << "group commit TEST#" << i << std::endl;
+  }
+  CLOG_E("test#4") << "group commit sync on error" << std::endl;
+  tools::log::Flush();
+
+  // 二进制日志, 使用 log_decode test5.bin 还原
+  tools::log::Config bin_cfg{"test#5", "%d{%H:%M:%S.%f} [%p] (%f:%l@%c) %m", true, true, "test5.bin",
+                             tools::log::flush::BYTES, 4096};
+  bin_cfg.binary = true;
+  tools::log::RegisterLogger(bin_cfg);
+  for (int i = 0; i < 3; i++) {
+    CLOG_BIN("test#5", "binary TEST#%d %s %.2f %5.3s|%-4u|%x\n", i, "str", 3.14159, std::string("abcdef"), 7u, 255);
+  }
+  CLOG_W("test#5") << "text in binary file" << std::endl;
+  CLOG_BIN_E("test#5", "no args\n");
+
+  // 内存映射文件, 关闭时截断至实际大小
+  tools::log::Config mmap_cfg{"test#6", "%d [%p] %m", false, true, "test6.log"};
+  mmap_cfg.mmap = true;
+  mmap_cfg.mmapChunk = 4096;
+  tools::log::RegisterLogger(mmap_cfg);
+  for (int i = 0; i < 1000; i++) {
+    CLOG("test#6") << "mmap TEST#" << i << std::endl;
+  }
+  tools::log::UnregisterLogger("test#6");
+
+  // 按大小轮转, 保留最近 3 个历史文件并在后台压缩
+  tools::log::Config rotate_cfg{"test#7", "%d [%p] %m", false, true, "test7.log"};
+  rotate_cfg.rotateBytes = 1024;
+  rotate_cfg.rotateKeep = 3;
+  rotate_cfg.rotateCompress = true;
+  tools::log::RegisterLogger(rotate_cfg);
+  for (int i = 0; i < 200; i++) {
+    CLOG("test#7") << "rotate TEST#" << i << std::endl;
+  }
+
+  // 结构化字段, 控制台以 key=value 输出, 同时写入 JSON Lines 文件
+  tools::log::Config json_cfg{"test#9", "[%p] %k%m", true, false, ""};
+  json_cfg.jsonFile = "test9.jsonl";
+  tools::log::RegisterLogger(json_cfg);
+  CLOG("test#9").With("user", 42).With("latency_us", 13.75) << "request handled" << std::endl;
+  CLOG_FMT_W("test#9", "json TEST#{}\n", 1).With("point", Point{1, 2.5, "p"}).With("ids", std::vector<int>{1, 2});
+  CLOG_E("test#9", "quoted \"%s\"\n", "str").With("path", "C:\\tmp\tx").With("ok", false).With("none", nullptr);
+
+  // 多输出端, DEBUG 及以上写入文件, 仅 WARN 及以上以简短格式输出至控制台
+  tools::log::Config sinks_cfg{"test#10", "%d [%p] (%f:%l) %m", false, false, ""};
+  sinks_cfg.sinks = {
+    {tools::log::sink::FILE, tools::log::level::DEBUG, "", "test10.log"},
+    {tools::log::sink::FILE, tools::log::level::ERROR, "", "test10.err.log"},
+    {tools::log::sink::CONSOLE, tools::log::level::WARN, "[%p] %m"},
+  };
+  tools::log::RegisterLogger(sinks_cfg);
+  CLOG("test#10") << "sinks TEST#" << 1 << std::endl;
+  CLOG_W("test#10") << "sinks TEST#" << 2 << std::endl;
+  CLOG_E("test#10") << "sinks TEST#" << 3 << std::endl;
+
+  // 日志发送, 本例在同一进程内接收, 实际由 log_collect 在另一进程接收并写入文件
+  int collector = nn_socket(AF_SP, NN_PULL);
+  int timeout = 1000;
+  nn_setsockopt(collector, NN_SOL_SOCKET, NN_RCVTIMEO, &timeout, sizeof(timeout));
+  nn_bind(collector, "ipc:///tmp/test11.ipc");
+  tools::log::Config ship_cfg{"test#11", "[%p] %m", false, false, ""};
+  ship_cfg.sinks = {{tools::log::sink::NET, tools::log::level::INFO, "", "", "ipc:///tmp/test11.ipc"}};
+  tools::log::RegisterLogger(ship_cfg);
+  // 连接在后台建立, 建立前发送的消息会被丢弃
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  CLOG_W("test#11") << "ship TEST#" << 1 << std::endl;
+  char* shipped = nullptr;
+  int shipped_size = nn_recv(collector, &shipped, NN_MSG, 0);
+  if (shipped_size > 1) {
+    std::cout << "received: " << std::string_view(shipped + 1, shipped_size - 1);
+    nn_freemsg(shipped);
+  }
+  nn_close(collector);
+
+  // 共享内存输出, 读取方同 log_tail, 取出后删除段, 避免残留的段在下次运行时占满
+  tools::log::Config shm_cfg{"test#12", "%d [%p] %m", false, false, ""};
+  tools::log::SinkConfig shm_sink;
+  shm_sink.type = tools::log::sink::SHM;
+  shm_sink.address = "/test12.log";
+  shm_sink.shmSize = 1024 * 1024;
+  shm_cfg.sinks = {shm_sink};
+  tools::log::shm::Ring::Remove(shm_sink.address);
+  tools::log::RegisterLogger(shm_cfg);
+  CLOG("test#12") << "shm TEST#" << 1 << std::endl;
+  tools::log::shm::Ring shm_reader;
+  std::string shm_line;
+  if (shm_reader.Open(shm_sink.address, 0)) {
+    shm_reader.Read([&shm_line](tools::log::level::LEVEL, std::string_view line) {
+      shm_line.append(line);
+    });
+  }
+  tools::log::shm::Ring::Remove(shm_sink.address);
+  if (!shm_line.ends_with("[INFO] shm TEST#1\n")) {
+    std::cerr << "shm mismatch: " << shm_line << std::endl;
+    return 1;
+  }
+  std::cout << "shm received: " << shm_line;
+
+  // 带索引的文件, 由 log_query test13.log -l ERROR 仅读取包含 ERROR 的块
+  tools::log::Config index_cfg{"test#13", "%d{%Y-%m-%d %H:%M:%S.%L} [%p] %m", false, true, "test13.log"};
+  index_cfg.flushPolicy = tools::log::flush::BYTES;
+  index_cfg.indexBlock = 4 * 1024;
+  tools::log::RegisterLogger(index_cfg);
+  for (int i = 0; i < 1000; i++) {
+    if (i % 300 == 299) {
+      CLOG_E("test#13") << "index TEST#" << i << std::endl;
+    } else {
+      CLOG("test#13") << "index TEST#" << i << std::endl;
+    }
+  }
+  tools::log::UnregisterLogger("test#13");
+
+  // 时间戳仅记录原始计数, 输出时换算, 与系统时间的偏差应在微秒级
+  auto ticks = tools::tick::Now();
+  auto drift = tools::tick::ToNanos(ticks) - std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  LOG("tick source=%d frequency=%.0f drift_ns=%lld\n", tools::tick::Source(), tools::tick::Frequency(),
+      static_cast<long long>(drift));
+
+  // 采样/限流, 被抑制的条数按周期汇总输出
+  tools::log::SetSuppressReportInterval(50);
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 100; i++) {
+      LOG_FIRST_N(3, "first_n TEST#%d\n", i);
+      LOG_EVERY_N_W(40) << "every_n TEST#" << i << std::endl;
+      CLOG_RATE_LIMITED_E("test#1", 1, 2, "rate_limited TEST#%d\n", i);
+      LOG_EVERY_T(1000, "every_t TEST#%d\n", i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  }
+
+  // 异步输出
+  tools::log::EnableAsync({1024, tools::log::overflow::BLOCK});
+  for (int i = 0; i < 10; i++) {
+    CLOG("test#1") << "async TEST#" << i << std::endl;
+  }
+  tools::log::Flush();
+  tools::log::DisableAsync();
+
+  // 多线程异步输出, 各线程独立入队, 线程退出后剩余消息仍会输出
+  tools::log::EnableAsync({256, tools::log::overflow::BLOCK, true});
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([t]{
+      for (int i = 0; i < 1000; i++) {
+        CLOG("test#4") << "thread#" << t << " async TEST#" << i << std::endl;
+      }
+    });
+  }
+  for (auto& i : threads) {
+    i.join();
+  }
+  CLOG("test#1") << "threads joined" << std::endl;
+  tools::log::Flush();
+  tools::log::DisableAsync();
+  LOG_W() << "sync again" << std::endl;
+
+  // 运行统计
+  auto stats = tools::log::GetStats();
+  for (auto& i : stats.loggers) {
+    std::cout << "stats " << i.name << " messages=" << i.messages << " bytes=" << i.bytes
+              << " dropped=" << i.dropped << " filtered=" << i.filtered
+              << " format_p50=" << i.format.Percentile(50) << "ns write_p99=" << i.write.Percentile(99)
+              << "ns sync_p99=" << i.sync.Percentile(99) << "ns" << std::endl;
+  }
+  tools::log::SetStatsReportInterval(20);
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  tools::log::SetStatsReportInterval(0);
 }
\ No newline at end of file